@@ -0,0 +1,246 @@
+// Micro benchmarks of the per frame work of the driver: conversion, serialization,
+// saving, Exif metadata, preview grid and ROS message construction, over image
+// size and number of cameras. Built when Google Benchmark is installed, run e.g.
+//   rosrun spinnaker_sdk_camera_driver acquisition_benchmarks --benchmark_filter=Imwrite
+
+#include "spinnaker_sdk_camera_driver/std_include.h"
+#include "spinnaker_sdk_camera_driver/serialization.h"
+#include "spinnaker_sdk_camera_driver/frame_output.h"
+#include "spinnaker_sdk_camera_driver/SpinnakerImageSet.h"
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <benchmark/benchmark.h>
+
+using namespace Spinnaker;
+using namespace acquisition;
+
+namespace {
+
+    const int resolutions[][2] = {{720, 540}, {1440, 1080}, {2448, 2048}};
+    const int camera_counts[] = {1, 4, 8};
+    const char* formats[] = {".bmp", ".tiff", ".jpg", ".png"};
+
+    // a gradient with some noise, so the encoders see a realistic amount of detail
+    Mat test_image(int width, int height, int type) {
+
+        Mat image(height, width, type);
+        for (int y = 0; y < height; y++)
+            image.row(y).setTo(Scalar::all(y * 223 / height));
+        Mat noise(height, width, type);
+        theRNG().state = 42;
+        randu(noise, Scalar::all(0), Scalar::all(32));
+        return image + noise;
+
+    }
+
+    string temp_file(const string& name) {
+
+        return (boost::filesystem::temp_directory_path() / ("acquisition_benchmark_" + name)).string();
+
+    }
+
+    void set_bytes(benchmark::State& state, const Mat& image, int count = 1) {
+
+        state.SetBytesProcessed(int64_t(state.iterations()) * image.total() * image.elemSize() * count);
+
+    }
+
+    void Resolutions(benchmark::internal::Benchmark* b) {
+        for (int r = 0; r < 3; r++)
+            b->Args({resolutions[r][0], resolutions[r][1]});
+    }
+
+    void ResolutionsAndColor(benchmark::internal::Benchmark* b) {
+        for (int r = 0; r < 3; r++)
+            for (int color = 0; color < 2; color++)
+                b->Args({resolutions[r][0], resolutions[r][1], color});
+    }
+
+    void ResolutionsAndFormats(benchmark::internal::Benchmark* b) {
+        for (int r = 0; r < 3; r++)
+            for (int f = 0; f < 4; f++)
+                b->Args({resolutions[r][0], resolutions[r][1], f});
+    }
+
+    void ResolutionsAndCameras(benchmark::internal::Benchmark* b) {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 3; c++)
+                b->Args({resolutions[r][0], resolutions[r][1], camera_counts[c]});
+    }
+
+}
+
+// Camera::convert_to_mat(): Spinnaker conversion of the raw image and copy into a Mat
+static void BM_SpinnakerConvert(benchmark::State& state) {
+
+    bool color = state.range(2);
+    Mat raw = test_image(state.range(0), state.range(1), CV_8UC1);
+    ImagePtr image = Image::Create(raw.cols, raw.rows, 0, 0, color ? PixelFormat_BayerRG8 : PixelFormat_Mono8, raw.data);
+    for (auto _ : state) {
+        ImagePtr converted = image->Convert(color ? PixelFormat_BGR8 : PixelFormat_Mono8);
+        Mat wrapped(converted->GetHeight() + converted->GetYPadding(), converted->GetWidth() + converted->GetXPadding(),
+                    color ? CV_8UC3 : CV_8UC1, converted->GetData(), converted->GetStride());
+        Mat frame = wrapped.clone();
+        benchmark::DoNotOptimize(frame.data);
+    }
+    set_bytes(state, raw);
+    state.SetLabel(color ? "BayerRG8->BGR8" : "Mono8");
+
+}
+BENCHMARK(BM_SpinnakerConvert)->Apply(ResolutionsAndColor)->Unit(benchmark::kMillisecond);
+
+static void BM_MatClone(benchmark::State& state) {
+
+    Mat image = test_image(state.range(0), state.range(1), state.range(2) ? CV_8UC3 : CV_8UC1);
+    for (auto _ : state) {
+        Mat copy = image.clone();
+        benchmark::DoNotOptimize(copy.data);
+    }
+    set_bytes(state, image);
+
+}
+BENCHMARK(BM_MatClone)->Apply(ResolutionsAndColor)->Unit(benchmark::kMicrosecond);
+
+// save_binary_frames(): boost serialization of a Mat into a file
+static void BM_SaveBinary(benchmark::State& state) {
+
+    Mat image = test_image(state.range(0), state.range(1), CV_8UC3);
+    string filename = temp_file("save.bin");
+    for (auto _ : state) {
+        std::ofstream ofs(filename.c_str());
+        boost::archive::binary_oarchive oa(ofs);
+        oa << image;
+        ofs.close();
+    }
+    set_bytes(state, image);
+    remove(filename.c_str());
+
+}
+BENCHMARK(BM_SaveBinary)->Apply(Resolutions)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadBinary(benchmark::State& state) {
+
+    Mat image = test_image(state.range(0), state.range(1), CV_8UC3);
+    string filename = temp_file("load.bin");
+    {
+        std::ofstream ofs(filename.c_str());
+        boost::archive::binary_oarchive oa(ofs);
+        oa << image;
+    }
+    for (auto _ : state) {
+        Mat loaded;
+        std::ifstream ifs(filename.c_str());
+        boost::archive::binary_iarchive ia(ifs);
+        ia >> loaded;
+        benchmark::DoNotOptimize(loaded.data);
+    }
+    set_bytes(state, image);
+    remove(filename.c_str());
+
+}
+BENCHMARK(BM_LoadBinary)->Apply(Resolutions)->Unit(benchmark::kMillisecond);
+
+// save_mat_frames(): imwrite of a color frame in each save_type
+static void BM_Imwrite(benchmark::State& state) {
+
+    Mat image = test_image(state.range(0), state.range(1), CV_8UC3);
+    string filename = temp_file("imwrite") + formats[state.range(2)];
+    for (auto _ : state)
+        imwrite(filename, image);
+    set_bytes(state, image);
+    state.SetLabel(formats[state.range(2)] + 1);
+    remove(filename.c_str());
+
+}
+BENCHMARK(BM_Imwrite)->Apply(ResolutionsAndFormats)->Unit(benchmark::kMillisecond);
+
+// metadata written into every saved image, rewriting the file
+static void BM_WriteExif(benchmark::State& state) {
+
+    Mat image = test_image(state.range(0), state.range(1), CV_8UC3);
+    string filename = temp_file("exif.jpg");
+    imwrite(filename, image);
+
+    boost::property_tree::ptree ptree;
+    ptree.put("camera.block_name", "benchmark");
+    ptree.put("camera.cam_no", 0);
+    ptree.put("camera.image_number", 1234);
+    ptree.put("camera.lat", 44.97);
+    ptree.put("camera.lon", -93.23);
+    ptree.put("camera.trigger_matched", true);
+    ptree.put("time.device_ns", 123456789012345);
+    ptree.put("time.ros_ns", 1500000000123456789);
+    for (auto _ : state)
+        write_exif_metadata(filename, ptree);
+    remove(filename.c_str());
+
+}
+BENCHMARK(BM_WriteExif)->Apply(Resolutions)->Unit(benchmark::kMillisecond);
+
+// update_grid(): live preview of all cameras, half of them mono so tiles are converted too
+static void BM_ComposeGrid(benchmark::State& state) {
+
+    int cams = state.range(2);
+    vector<Mat> frames;
+    for (int i = 0; i < cams; i++)
+        frames.push_back(test_image(state.range(0), state.range(1), i % 2 ? CV_8UC1 : CV_8UC3));
+    Mat grid(frames[0].rows, frames[0].cols * cams, CV_8UC3);
+    for (auto _ : state) {
+        compose_grid(frames, grid);
+        benchmark::DoNotOptimize(grid.data);
+    }
+    set_bytes(state, grid);
+
+}
+BENCHMARK(BM_ComposeGrid)->Apply(ResolutionsAndCameras)->Unit(benchmark::kMillisecond);
+
+// export_to_ROS(): one image message per camera, the publishing itself is not included
+static void BM_ExportToROS(benchmark::State& state) {
+
+    int cams = state.range(2);
+    vector<Mat> frames(cams, test_image(state.range(0), state.range(1), CV_8UC3));
+    vector<sensor_msgs::ImagePtr> img_msgs(cams);
+    vector<sensor_msgs::CameraInfoPtr> cam_info_msgs;
+    for (int i = 0; i < cams; i++)
+        cam_info_msgs.push_back(sensor_msgs::CameraInfoPtr(new sensor_msgs::CameraInfo()));
+
+    for (auto _ : state) {
+        for (int i = 0; i < cams; i++) {
+            std_msgs::Header img_msg_header;
+            img_msg_header.frame_id = "cam_" + to_string(i) + "_optical_frame";
+            img_msg_header.stamp = ros::Time(1500000000, i);
+            cam_info_msgs[i]->header = img_msg_header;
+            img_msgs[i] = cv_bridge::CvImage(img_msg_header, "bgr8", frames[i]).toImageMsg();
+        }
+        benchmark::DoNotOptimize(img_msgs[0]->data.data());
+    }
+    set_bytes(state, frames[0], cams);
+
+}
+BENCHMARK(BM_ExportToROS)->Apply(ResolutionsAndCameras)->Unit(benchmark::kMillisecond);
+
+// publish_frame_set(): all images converted straight into one set message
+static void BM_FrameSetMessage(benchmark::State& state) {
+
+    int cams = state.range(2);
+    vector<Mat> frames(cams, test_image(state.range(0), state.range(1), CV_8UC3));
+    for (auto _ : state) {
+        spinnaker_sdk_camera_driver::SpinnakerImageSetPtr set_msg(new spinnaker_sdk_camera_driver::SpinnakerImageSet());
+        set_msg->images.resize(cams);
+        set_msg->camera_infos.resize(cams);
+        for (int i = 0; i < cams; i++) {
+            std_msgs::Header img_msg_header;
+            img_msg_header.frame_id = "cam_" + to_string(i) + "_optical_frame";
+            cv_bridge::CvImage(img_msg_header, "bgr8", frames[i]).toImageMsg(set_msg->images[i]);
+            set_msg->camera_infos[i].header = img_msg_header;
+        }
+        benchmark::DoNotOptimize(set_msg->images[0].data.data());
+    }
+    set_bytes(state, frames[0], cams);
+
+}
+BENCHMARK(BM_FrameSetMessage)->Apply(ResolutionsAndCameras)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
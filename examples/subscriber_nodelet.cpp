@@ -2,14 +2,19 @@
 // Created by pushyami on 1/15/19.
 //
 //cpp
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <vector>
 // ROS
 #include <ros/ros.h>
 #include <image_transport/image_transport.h>
-//#include <cv_bridge/cv_bridge.h>
+#include <boost/thread/mutex.hpp>
 // msgs
 #include "sensor_msgs/Image.h"
-//#include "sensor_msgs/CameraInfo.h"
+#include "spinnaker_sdk_camera_driver/SubscriberBenchmark.h"
+
+#include "spinnaker_sdk_camera_driver/histogram.h"
 
 // nodelets
 #include <nodelet/nodelet.h>
@@ -21,17 +26,42 @@ namespace subscriber_nodelet_ns
 {
     class subscriber_nodelet: public nodelet::Nodelet
     {
-    //This is a test nodelet for  measuring nodelet performance
+    // Benchmark consumer for measuring the publish path of the driver, in-process
+    // (same nodelet manager) or across processes. For every image topic it records
+    // latency (header stamp to receive), inter-arrival time, seq gaps and bandwidth
+    // without copying the images, and reports percentile summaries periodically.
         public:
             subscriber_nodelet(){}
             ~subscriber_nodelet()
             {
+                topics_.clear();
                 it_.reset();
             }
 
+            struct TopicStats {
+                std::string topic;
+                image_transport::Subscriber sub;
+                acquisition::Histogram latency;         // us
+                acquisition::Histogram inter_arrival;   // us
+                std::atomic<uint64_t> received;
+                std::atomic<uint64_t> dropped;
+                std::atomic<uint64_t> bytes;
+                // only touched from the topic's own callback
+                ros::Time last_receive;
+                uint32_t last_seq;
+            };
+
             std::shared_ptr<image_transport::ImageTransport> it_;
-            image_transport::Subscriber image_sub_;
-            
+            std::vector<std::shared_ptr<TopicStats> > topics_;
+            boost::mutex topics_mutex_;
+
+            ros::Publisher benchmark_pub_;
+            ros::Timer discovery_timer_;
+            ros::Timer report_timer_;
+            ros::Time last_report_;
+            double report_interval_;
+            int queue_size_;
+
             virtual void onInit()
             {
                 NODELET_INFO("Initializing Subscriber nodelet");
@@ -39,19 +69,127 @@ namespace subscriber_nodelet_ns
                 ros::NodeHandle& private_nh = getPrivateNodeHandle();
 
                 it_.reset(new image_transport::ImageTransport(node));
-                image_sub_ = it_->subscribe("/camera_array/cam0/image_raw",1, &subscriber_nodelet::imgCallback, this);
+                private_nh.param("report_interval", report_interval_, 5.0);
+                private_nh.param("queue_size", queue_size_, 5);
+                benchmark_pub_ = private_nh.advertise<spinnaker_sdk_camera_driver::SubscriberBenchmark>("benchmark", 10);
+
+                std::vector<std::string> topics;
+                if (private_nh.getParam("topics", topics)) {
+                    for (int i = 0; i < topics.size(); i++)
+                        subscribe(topics[i]);
+                } else {
+                    NODELET_INFO("'topics' not set, subscribing to all camera_array/*/image_raw topics");
+                    discovery_timer_ = node.createTimer(ros::Duration(1.0), &subscriber_nodelet::discoverTopics, this);
+                }
+
+                last_report_ = ros::Time::now();
+                report_timer_ = node.createTimer(ros::Duration(report_interval_), &subscriber_nodelet::report, this);
                 NODELET_INFO("onInit for Subscriber nodelet Initialized");
             }
 
-            void imgCallback(const sensor_msgs::Image::ConstPtr& msg)
+            void discoverTopics(const ros::TimerEvent&)
+            {
+                ros::master::V_TopicInfo topic_infos;
+                if (!ros::master::getTopics(topic_infos))
+                    return;
+
+                const std::string suffix = "/image_raw";
+                for (int i = 0; i < topic_infos.size(); i++) {
+                    const std::string& name = topic_infos[i].name;
+                    if (topic_infos[i].datatype != "sensor_msgs/Image")
+                        continue;
+                    if (name.find("camera_array/") == std::string::npos || name.size() < suffix.size() ||
+                        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+                        continue;
+                    subscribe(name);
+                }
+            }
+
+            void subscribe(const std::string& topic)
+            {
+                boost::mutex::scoped_lock lock(topics_mutex_);
+                for (int i = 0; i < topics_.size(); i++)
+                    if (topics_[i]->topic == topic)
+                        return;
+
+                std::shared_ptr<TopicStats> stats(new TopicStats());
+                stats->topic = topic;
+                stats->received = 0;
+                stats->dropped = 0;
+                stats->bytes = 0;
+                stats->last_seq = 0;
+                // the subscriber is owned by stats, so bind a plain pointer to avoid a cycle
+                stats->sub = it_->subscribe(topic, queue_size_,
+                                            boost::bind(&subscriber_nodelet::imgCallback, this, _1, stats.get()));
+                topics_.push_back(stats);
+                NODELET_INFO_STREAM("Benchmarking " << topic);
+            }
+
+            void imgCallback(const sensor_msgs::Image::ConstPtr& msg, TopicStats* stats)
+            {
+                // dont modify or copy the input msg, only its header and size are looked at
+                ros::Time now = ros::Time::now();
+
+                if (!msg->header.stamp.isZero() && now > msg->header.stamp)
+                    stats->latency.record((now - msg->header.stamp).toNSec() / 1000);
+                if (!stats->last_receive.isZero())
+                    stats->inter_arrival.record((now - stats->last_receive).toNSec() / 1000);
+
+                // roscpp only fills in seq when serializing, so in-process gaps can't be seen this way
+                if (stats->received.load(std::memory_order_relaxed) > 0 && msg->header.seq > stats->last_seq + 1)
+                    stats->dropped.fetch_add(msg->header.seq - stats->last_seq - 1, std::memory_order_relaxed);
+
+                stats->last_seq = msg->header.seq;
+                stats->last_receive = now;
+                stats->received.fetch_add(1, std::memory_order_relaxed);
+                stats->bytes.fetch_add(msg->data.size(), std::memory_order_relaxed);
+            }
+
+            static void fillStats(spinnaker_sdk_camera_driver::HistogramStats& out, const std::string& name,
+                                  const acquisition::HistogramSummary& summary)
             {
-                // dont modify the input msg in any way
-                sensor_msgs::Image tmp_img = *msg;
-                NODELET_INFO_STREAM("diff time is "<< ros::Time::now().toSec() - tmp_img.header.stamp.toSec());
-                // copy input img to cv::mat and do any cv stuff
-                // dont do time intense stuff in callbacks
+                out.name = name;
+                out.unit = "ms";
+                out.count = summary.count;
+                out.min = summary.min;
+                out.mean = summary.mean;
+                out.p50 = summary.p50;
+                out.p90 = summary.p90;
+                out.p99 = summary.p99;
+                out.max = summary.max;
+            }
+
+            void report(const ros::TimerEvent&)
+            {
+                ros::Time now = ros::Time::now();
+                double interval = (now - last_report_).toSec();
+                last_report_ = now;
+                if (interval <= 0)
+                    return;
+
+                boost::mutex::scoped_lock lock(topics_mutex_);
+                for (int i = 0; i < topics_.size(); i++) {
+                    TopicStats& stats = *topics_[i];
+
+                    spinnaker_sdk_camera_driver::SubscriberBenchmark msg;
+                    msg.header.stamp = now;
+                    msg.topic = stats.topic;
+                    msg.received = stats.received.exchange(0, std::memory_order_relaxed);
+                    msg.dropped = stats.dropped.exchange(0, std::memory_order_relaxed);
+                    msg.fps = msg.received / interval;
+                    msg.megabytes_per_sec = stats.bytes.exchange(0, std::memory_order_relaxed) / interval / 1e6;
+                    fillStats(msg.latency, "latency", stats.latency.summarize(1e-3, true));
+                    fillStats(msg.inter_arrival, "inter_arrival", stats.inter_arrival.summarize(1e-3, true));
+                    benchmark_pub_.publish(msg);
+
+                    NODELET_INFO("%s: %.1f fps, %.1f MB/s, %lu dropped | latency ms p50 %.2f p90 %.2f p99 %.2f max %.2f"
+                                 " | inter-arrival ms p50 %.2f p99 %.2f max %.2f",
+                                 stats.topic.c_str(), msg.fps, msg.megabytes_per_sec, (unsigned long)msg.dropped,
+                                 msg.latency.p50, msg.latency.p90, msg.latency.p99, msg.latency.max,
+                                 msg.inter_arrival.p50, msg.inter_arrival.p99, msg.inter_arrival.max);
+                }
             }
     };
 }
 
-PLUGINLIB_EXPORT_CLASS(subscriber_nodelet_ns::subscriber_nodelet, nodelet::Nodelet)
\ No newline at end of file
+PLUGINLIB_EXPORT_CLASS(subscriber_nodelet_ns::subscriber_nodelet, nodelet::Nodelet)
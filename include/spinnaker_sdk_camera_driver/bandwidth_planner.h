@@ -0,0 +1,66 @@
+#ifndef BANDWIDTH_PLANNER_HEADER
+#define BANDWIDTH_PLANNER_HEADER
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Splits the bandwidth of each USB host controller between the cameras
+     * attached to it.
+     *
+     * Every camera is added with the controller it hangs off and the bytes/s it
+     * needs at its frame rate. Each controller's budget is shared in proportion
+     * to the needs of its cameras, so a controller with headroom gives every
+     * camera some margin, and an oversubscribed one slows all of its cameras
+     * down evenly instead of letting them corrupt each other's images. A camera
+     * whose controller is unknown is left unlimited.
+     */
+    class BandwidthPlanner {
+
+    public:
+
+        BandwidthPlanner(double controller_bps = 0) { controller_bps_ = controller_bps; }
+
+        void set_controller_bandwidth(double bps) { controller_bps_ = bps; }
+        void add(int cam, const string& controller, double required_bps);
+        void plan();
+
+        // planned limit in bytes/s, 0 if the camera is not limited
+        int64_t limit(int cam) const;
+        // false if the controller of cam can't carry the requested rates
+        bool feasible(int cam) const;
+        double required(int cam) const;
+
+        // controllers with their total required bytes/s
+        const map<string, double>& controller_loads() const { return loads_; }
+        double controller_bandwidth() const { return controller_bps_; }
+
+        // sysfs path of the USB host controller of the camera with this serial, empty if not found
+        static string usb_controller(const string& serial);
+
+    private:
+
+        struct Link {
+            string controller;
+            double required_bps;
+            int64_t limit_bps;
+            bool feasible;
+        };
+
+        const Link* link(int cam) const;
+
+        double controller_bps_;
+        map<int, Link> links_;
+        map<string, double> loads_;
+
+    };
+
+}
+
+#endif
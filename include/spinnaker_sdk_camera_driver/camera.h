@@ -3,8 +3,11 @@
 
 #include "std_include.h"
 #include "serialization.h"
+#include "frame_source.h"
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <atomic>
 
 using namespace Spinnaker;
 using namespace Spinnaker::GenApi;
@@ -14,22 +17,73 @@ using namespace std;
 
 namespace acquisition {
 
+    // per frame values sent by the camera as chunk data along with the image
+    struct ChunkMetadata {
+        bool valid;
+        double exposure_time_us;
+        double gain_db;
+        int64_t device_timestamp_ns;
+        int64_t frame_id;
+        int64_t line_status;    // ExposureEndLineStatusAll
+    };
+
+    // images lost by a camera, counted by the grab thread and read by the diagnostics
+    struct FrameCounters {
+        std::atomic<uint64_t> frames;       // complete images
+        std::atomic<uint64_t> incomplete;
+        std::atomic<uint64_t> skipped_ids;  // frame IDs missing between consecutive images
+        std::atomic<uint64_t> timeouts;     // grabs that ended without an image
+
+        FrameCounters() : frames(0), incomplete(0), skipped_ids(0), timeouts(0) {}
+    };
+
+    // transport layer counters of the image stream since acquisition start, -1 where the device has none
+    struct StreamCounters {
+        int64_t lost_frames;        // never arrived from the camera
+        int64_t failed_buffers;     // arrived incomplete
+        int64_t dropped_frames;     // discarded by the buffer handling as the driver didn't grab them in time
+        int64_t buffer_underruns;   // no free buffer for an arriving image
+        int64_t resend_requests;    // packets requested again (GigE)
+
+        StreamCounters() : lost_frames(-1), failed_buffers(-1), dropped_frames(-1), buffer_underruns(-1), resend_requests(-1) {}
+    };
+
     class Camera {
 
     public:
 
         ~Camera();
         Camera(CameraPtr);
+        // a camera without a device, its images come from source
+        Camera(std::shared_ptr<FrameSource> source);
 
         void init();
         void deinit();
         void begin_acquisition();
         void end_acquisition();
+        bool is_initialized() { return source_ ? source_->is_initialized() : pCam_->IsInitialized(); }
+        bool is_streaming() { return source_ ? source_->is_streaming() : pCam_->IsStreaming(); }
+        bool is_clean();
+        bool is_connected() { return source_ || (pCam_.IsValid() && pCam_->IsValid()); }
+        bool is_simulated() { return (bool)source_; }
+        void release_device();
+        void attach_device(CameraPtr);
+        int drain_buffers();
 
         ImagePtr grab_frame();
-        Mat grab_mat_frame();
+        bool grab_mat_frame(Mat& frame, bool convert = true);
         string get_time_stamp();
+        int64_t get_timestamp_ns() { return timestamp_; }
         int get_frame_id();
+        bool latch_timestamp(int64_t& device_ns, int64_t& host_before_ns, int64_t& host_after_ns);
+        bool enableChunkData();
+        bool load_user_set(const string& user_set) { return execute_user_set_command(user_set, "UserSetLoad"); }
+        bool save_user_set(const string& user_set) { return execute_user_set_command(user_set, "UserSetSave"); }
+        const ChunkMetadata& get_chunk_metadata() { return chunk_; }
+        const FrameCounters& get_counters() { return *counters_; }
+        // reads the TL stream nodemap, safe to call from another thread than the one grabbing
+        void read_stream_counters(StreamCounters& counters);
+        static bool read_chunk_data(ImagePtr, ChunkMetadata&);
 
         void setEnumValue(string, string);
         void setIntValue(string, int);
@@ -43,7 +97,10 @@ namespace acquisition {
         void setPixelFormat(gcstring formatPic);
         void exposureTest();
         void setResolutionPixels(int width, int height);
-        void setBufferSize(int numBuf);
+        int setBufferSize(int numBuf);
+        bool setBufferHandlingMode(const string& mode);
+        int64_t getPayloadSize();
+        int64_t setThroughputLimit(int64_t bps);
         void adcBitDepth(gcstring bitDep);
         void targetGreyValueTest();
 
@@ -61,26 +118,70 @@ namespace acquisition {
 
         string getTLNodeStringValue(string node_string);
         double getFloatValueMax(string node_string);
-        string get_id();
+        int getIntValueMax(string node_string);
+        string get_id() { return serial_; }
+        string get_model() { return model_; }
         void make_master() { MASTER_ = true; ROS_DEBUG_STREAM( "camera " << get_id() << " set as master"); }
         bool is_master() { return MASTER_; }
         void set_color(bool flag) { COLOR_ = flag; }
         void setGetNextImageTimeout(uint64_t get_next_image_timeout) { GET_NEXT_IMAGE_TIMEOUT_ = get_next_image_timeout; }
+        // without a timeout the grab waits in slices and gives up without an image once abort returns true
+        void set_grab_abort(const boost::function<bool()>& abort) { grab_abort_ = abort; }
         bool verifyBinning(int binningDesired);
         void calibrationParamsTest(int calibrationWidth, int calibrationHeight);
         
     private:
 
         Mat convert_to_mat(ImagePtr);
+        ImagePtr grab_source_frame();
+        ImagePtr next_image();
+        void count_frame(int frame_id);
+        void resolve_nodes();
+        bool execute_user_set_command(const string& user_set, const char* command);
+
+        // returns the cached handle of a node, looking it up on first use
+        template <typename T>
+        T cached_node(map<string, T>& cache, const string& name) {
+            boost::mutex::scoped_lock lock(nodes_->mutex);
+            typename map<string, T>::iterator it = cache.find(name);
+            if (it != cache.end())
+                return it->second;
+            T ptr = pCam_->GetNodeMap().GetNode(name.c_str());
+            cache[name] = ptr;
+            return ptr;
+        }
+
+        // typed handles of the device nodes, valid between init() and deinit()
+        struct NodeCache {
+            map<string, CEnumerationPtr> enums;
+            map<string, CIntegerPtr> ints;
+            map<string, CFloatPtr> floats;
+            map<string, CBooleanPtr> bools;
+            CCommandPtr trigger_software;
+            CCommandPtr timestamp_latch;
+            CIntegerPtr timestamp_latch_value;
+            boost::mutex mutex;
+        };
+        // shared, as Camera objects are copied into the camera list
+        std::shared_ptr<NodeCache> nodes_;
+        std::shared_ptr<FrameCounters> counters_;
+        string serial_;
+        string model_;
         
         CameraPtr pCam_;
+        std::shared_ptr<FrameSource> source_;
         int64_t timestamp_;
         int frameID_;
         int lastFrameID_;
+        ChunkMetadata chunk_;
 
         bool COLOR_;
         bool MASTER_;
+        bool CHUNK_DATA_;
+        bool LEFT_INITIALIZED_;     // found initialized at construction, before it was cleaned up
         uint64_t GET_NEXT_IMAGE_TIMEOUT_;
+        boost::function<bool()> grab_abort_;
+        static const uint64_t GRAB_SLICE_MS = 100;
 
     };
 
@@ -4,9 +4,20 @@
 #include "std_include.h"
 #include "serialization.h"
 #include "camera.h"
+#include "compressed_publisher.h"
+#include "decimation.h"
+#include "clock_sync.h"
+#include "frame_set_assembler.h"
+#include "frame_output.h"
+#include "trigger_queue.h"
+#include "bandwidth_planner.h"
+#include "histogram.h"
+#include "trace.h"
+#include "memory_account.h"
 #include "spinnaker_configure.h"
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 //ROS
 #include "std_msgs/Float64.h"
 #include "std_msgs/Int64.h"
@@ -20,6 +31,14 @@
 #include <spinnaker_sdk_camera_driver/spinnaker_camConfig.h>
 
 #include "spinnaker_sdk_camera_driver/SpinnakerImageNames.h"
+#include "spinnaker_sdk_camera_driver/SpinnakerImageSet.h"
+#include "spinnaker_sdk_camera_driver/FrameMetadata.h"
+#include "spinnaker_sdk_camera_driver/SetImageFormat.h"
+#include "spinnaker_sdk_camera_driver/StageStats.h"
+#include "spinnaker_sdk_camera_driver/StreamStats.h"
+#include "spinnaker_sdk_camera_driver/MemoryStats.h"
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <std_srvs/Trigger.h>
 
 #include <sstream>
 #include <image_transport/image_transport.h>
@@ -51,11 +70,26 @@ namespace acquisition {
         virtual void onInit();
         
         std::shared_ptr<boost::thread> pubThread_;
+        std::shared_ptr<boost::thread> clockSyncThread_;
+        std::shared_ptr<boost::thread> hotplugThread_;
+        std::shared_ptr<boost::thread> streamStatsThread_;
 
         void load_cameras();
+        vector<acquisition::Camera> simulated_cameras();
         void init_variables_register_to_ros();
         void init_array();
+        bool wait_for_cameras(const char*, const boost::function<bool(int)>&);
         void init_cameras(bool);
+        bool configure_camera(int, bool);
+        void apply_configuration(int);
+        void apply_image_format(int);
+        void configure_buffers(int);
+        void plan_bandwidth();
+        string configuration_hash(int);
+        bool load_user_set(int);
+        void save_user_set(int);
+        void read_user_set_cache();
+        void for_each_camera(const boost::function<void(int)>&);
         void start_acquisition();
         void end_acquisition();
         void deinit_cameras();
@@ -64,6 +98,8 @@ namespace acquisition {
         void run_external_trig();
         void run_soft_trig();
         void run_mt();
+        void sync_clocks();
+        void watch_cameras();
         void publish_to_ros(int, char**, float);
 
         void read_parameters();
@@ -71,6 +107,15 @@ namespace acquisition {
         struct Metadata {
             ImagePtr image;
             msgs_and_srvs::ImageTriggerMsg trigger_message;
+            bool trigger_matched;
+            ros::Time stamp;
+            int64_t device_ns;
+            int frame_id;
+            ChunkMetadata chunk;
+            unsigned int sinks;
+            uint64_t set_index;
+            unsigned int set_size;      // images of the set that go to the frame set
+            MemoryTokenPtr memory;
         };
         
         void write_queue_to_disk(queue<Metadata>*, int);
@@ -84,12 +129,54 @@ namespace acquisition {
         void save_mat_frames(int);
         void save_binary_frames(int);
         void get_mat_images();
+        void trigger_master();
+        bool camera_online(int i) { return camera_states_[i]->online.load(); }
+        // rate at which the cameras deliver frames
+        double frame_rate() { return MAX_RATE_SAVE_ || !SOFT_FRAME_RATE_CTRL_ ? master_fps_ : soft_framerate_; }
         Mat convert_to_mat(ImagePtr);
         void update_grid();
+        ros::Time host_time(int, int64_t);
+        void put_time_metadata(boost::property_tree::ptree&, int64_t, const ros::Time&);
+        void put_chunk_metadata(boost::property_tree::ptree&, const ChunkMetadata&);
+        void publish_frame_metadata(int, const ChunkMetadata&, const std_msgs::Header&);
         void export_to_ROS();
+        void publish_frame_set();
+        void add_to_frame_set(uint64_t, unsigned int, int, uint64_t, const Mat&, const std_msgs::Header&);
+        void init_frame_set_assembly();
         void dynamicReconfigureCallback(spinnaker_sdk_camera_driver::spinnaker_camConfig &config, uint32_t level);
+        bool setImageFormatCallback(spinnaker_sdk_camera_driver::SetImageFormat::Request&,
+                                    spinnaker_sdk_camera_driver::SetImageFormat::Response&);
+        bool dumpTraceCallback(std_srvs::Trigger::Request&, std_srvs::Trigger::Response&);
+        void current_image_format(spinnaker_sdk_camera_driver::spinnaker_camConfig&);
+        bool reconfigure_image_format(const spinnaker_sdk_camera_driver::spinnaker_camConfig&);
+        void reconfigure_frame_rate(double);
+        void yield_to_reconfiguration();
+        void update_camera_info();
        
         float mem_usage();
+
+        // reads a parameter given either as one value for all cameras or as a list in cam_ids order
+        template <typename T>
+        bool read_per_camera_param(const string& name, vector<T>& values, const T& default_value) {
+            if (nh_pvt_.getParam(name, values)) {
+                ROS_ASSERT_MSG(values.size() == cam_ids_.size(),
+                               "If %s is provided as a list, it should be the same number as cam_ids and should correspond in order!", name.c_str());
+                return true;
+            }
+            T value;
+            bool found = nh_pvt_.getParam(name, value);
+            values.assign(cam_ids_.size(), found ? value : default_value);
+            return found;
+        }
+
+        // keeps the entries of the cameras in cams, given by their index in cam_ids, in the order of cams
+        template <typename T>
+        static void keep_connected(vector<T>& values, const vector<int>& configured) {
+            vector<T> connected;
+            for (size_t i = 0; i < configured.size(); i++)
+                connected.push_back(values[configured[i]]);
+            values.swap(connected);
+        }
     
        
 
@@ -102,8 +189,21 @@ namespace acquisition {
         unsigned int numCameras_;
         vector<CameraPtr> pCams_;
         vector<ImagePtr> pResultImages_;
+
+        // image memory held by the driver, declared before everything that holds images so it outlives their tokens
+        enum MemoryStage { MEM_ASSEMBLING, MEM_QUEUED, MEM_WRITING, MEM_FRAME_SET, MEM_COMPRESSING, MEM_CURRENT, NUM_MEMORY_STAGES };
+        MemoryAccount memory_;
+        static int64_t image_bytes(const Mat& frame) { return frame.total() * frame.elemSize(); }
+        // cam memory_.all() and stage memory_.total() for the sums, takes the peak of the interval
+        spinnaker_sdk_camera_driver::MemoryStats memory_stats(int cam, int stage);
+
         vector<Mat> frames_;
+        vector<MemoryTokenPtr> frame_memory_;
         vector<string> time_stamps_;
+        vector<uint64_t> frame_ids_;
+        vector<ros::Time> stamps_;
+        vector<int64_t> device_stamps_;
+        vector<ChunkMetadata> chunks_;
         vector< vector<Mat> > mem_frames_;
         vector<vector<double>> intrinsic_coeff_vec_;
         vector<vector<double>> distortion_coeff_vec_;
@@ -112,23 +212,77 @@ namespace acquisition {
         vector<string> imageNames;
         vector<bool> flip_horizontal_vec_;
         vector<bool> flip_vertical_vec_;
+
+        // per sink, per camera output decimation
+        SinkDecimator decimator_;
+        vector<unsigned int> sink_masks_;
+        vector< vector<int> > sink_every_;
+        vector< vector<double> > sink_rate_;
+
+        // matching of the cameras' frames into sets belonging to the same trigger
+        struct GrabbedFrame {
+            Mat frame;
+            unsigned int sinks;
+            string time_stamp;
+            int64_t device_ns;
+            ChunkMetadata chunk;
+            MemoryTokenPtr memory;
+        };
+        FrameSetAssembler<GrabbedFrame> grab_assembler_;
+        FrameSetAssembler<Metadata> queue_assembler_;
+        double sync_tolerance_;
+        int sync_window_;
+        bool PARTIAL_SETS_;
            
         string path_;
         string todays_date_;
 
         time_t time_now_;
-        double grab_time_, save_time_, toMat_time_, save_mat_time_, export_to_ROS_time_, achieved_time_;
+        double grab_time_, save_time_, toMat_time_, save_mat_time_, export_to_ROS_time_;
+
+        // processing time histograms per stage, per camera in max_rate_save mode and for the whole array otherwise
+        enum Stage { STAGE_GRAB, STAGE_CONVERT, STAGE_SAVE, STAGE_METADATA, STAGE_EXPORT, STAGE_DISPLAY, STAGE_TOTAL, NUM_STAGES };
+        struct StageTimes {
+            Histogram stages[NUM_STAGES];   // us
+            std::atomic<uint64_t> frames;
+            std::atomic<unsigned int> queue_size;
+        };
+        void record_stage(StageTimes& times, Stage stage, double secs) { times.stages[stage].record((uint64_t)(secs*1e6)); }
+        void publish_stage_stats(const ros::WallTimerEvent&);
+        void publish_stage_stats(const string&, int, StageTimes&, double, ros::Publisher&, ros::Publisher*);
+        vector< std::shared_ptr<StageTimes> > camera_times_;
+        std::shared_ptr<StageTimes> array_times_;
+        vector<ros::Publisher> stage_stats_pubs_;
+        ros::Publisher array_stage_stats_pub_;
+        ros::WallTimer stats_timer_;
+        ros::WallTime last_stats_;
+        double stats_interval_;
+
+        // frame loss per camera on /diagnostics, with the counts at the last publish for the rates
+        void publish_diagnostics(const ros::WallTimerEvent&);
+        void count_dropped(const vector<int>& cams);
+        ros::Publisher diagnostics_pub_;
+        ros::WallTimer diagnostics_timer_;
+        ros::WallTime last_diagnostics_;
+        vector< vector<uint64_t> > last_counts_;
+        vector<StreamCounters> last_stream_counters_;
+        double diagnostics_interval_;
+
+        // transport layer counters, polled slowly by their own thread as the nodemap reads take a while
+        void poll_stream_stats();
+        StreamCounters stream_counters(int cam_no);
+        spinnaker_sdk_camera_driver::StreamStats stream_stats(int cam_no);
+        vector<StreamCounters> stream_counters_;
+        boost::mutex stream_mutex_;
+        double stream_stats_interval_;
 
         int nframes_;
         float init_delay_;
         int skip_num_;
         float master_fps_;
-        int binning_;
-        bool color_;
+        int init_threads_;
         string dump_img_;
         string ext_;
-        float exposure_time_;
-        float gain_;
         double target_grey_value_;
         bool first_image_received;
         // int decimation_;
@@ -157,21 +311,89 @@ namespace acquisition {
         bool SOFT_FRAME_RATE_CTRL_;
         bool EXPORT_TO_ROS_;
         bool MAX_RATE_SAVE_;
+        bool LIMIT_MASTER_RATE_;    // the free running master runs at master_fps_ set at runtime instead of its maximum
         bool PUBLISH_CAM_INFO_;
+        bool PUBLISH_FRAME_SET_;
+        bool PUBLISH_COMPRESSED_;
+        bool CHUNK_DATA_;
         bool VERIFY_BINNING_;
+        bool FORCE_FLUSH_;
+        // host side stream buffers, sized automatically if buffer_count_ is 0
+        int buffer_count_;
+        double buffer_latency_;
+        double buffer_memory_;      // MB for all cameras
+        string buffer_handling_mode_;
+
+        // USB bandwidth per host controller in MB/s, 0 leaves the cameras unlimited
+        BandwidthPlanner bandwidth_planner_;
+        double usb_bandwidth_;
+        bool USER_SET_;
         uint64_t SPINNAKER_GET_NEXT_IMAGE_TIMEOUT_;
         
-        boost::optional<msgs_and_srvs::ImageTriggerMsg> nmea_trigger;
+        // GPS trigger messages waiting for their frames
+        TriggerQueue trigger_queue_;
+        double trigger_window_;
 
         void assignSoftwareTriggerCallback(const msgs_and_srvs::ImageTriggerMsg::ConstPtr& msg);
         ros::Subscriber software_trigger_sub_;
 
         
-        bool region_of_interest_set_;
-        int region_of_interest_width_;
-        int region_of_interest_height_;
-        int region_of_interest_x_offset_;
-        int region_of_interest_y_offset_;
+        // acquisition settings of each camera, given once for all cameras or as a list in cam_ids order
+        struct CameraSettings {
+            float exposure_time;
+            float gain;
+            int binning;
+            bool color;
+            bool roi_set;
+            int roi_width;
+            int roi_height;
+            int roi_x_offset;
+            int roi_y_offset;
+        };
+        // in cam_ids order until load_cameras() leaves the connected cameras in cams order
+        vector<CameraSettings> cam_settings_;
+
+        // configurations saved on the cameras, hash of the configuration per camera serial
+        string user_set_;
+        string user_set_cache_;
+        map<string, string> user_set_hashes_;
+        boost::mutex user_set_mutex_;
+
+        // connection state per camera, cameras that were unplugged are left out until they are back
+        struct CameraState {
+            std::atomic<bool> online;
+            std::atomic<bool> rejoined;     // set by the watchdog, taken by the acquisition thread
+            ros::WallTime lost_at;
+            unsigned int outages;
+            double outage_secs;
+            std::atomic<uint64_t> queue_drops;      // frames that matched no frame set
+            std::atomic<uint64_t> save_failures;
+            // held by the watchdog while it releases or reattaches the device and by the threads besides the
+            // acquisition threads while they use it, taken after acquisition_mutex_
+            boost::mutex device_mutex;
+        };
+        vector< std::shared_ptr<CameraState> > camera_states_;
+        double hotplug_interval_;
+
+        // simulated cameras in place of the Spinnaker devices: "synthetic" test images or "replay" of saved images
+        string frame_source_;
+        int synthetic_width_;
+        int synthetic_height_;
+        double synthetic_rate_;
+        double synthetic_jitter_;       // ms
+        string synthetic_drops_;
+        string replay_path_;
+
+        // device to host clock synchronization per camera
+        vector< std::shared_ptr<ClockSync> > clock_syncs_;
+        double clock_sync_interval_;
+
+        // driver side compressed output
+        CompressedPublisher compressed_pub_;
+        string compressed_format_;
+        int compressed_quality_;
+        double compressed_rate_;
+        int compressed_threads_;
 
         // grid view related variables
         bool GRID_CREATED_;
@@ -182,13 +404,29 @@ namespace acquisition {
         ros::NodeHandle nh_pvt_;
         std::shared_ptr<image_transport::ImageTransport> it_;
 
+        // shared by the dynamic reconfigure server and the set_image_format service
+        boost::recursive_mutex config_mutex_;
         dynamic_reconfigure::Server<spinnaker_sdk_camera_driver::spinnaker_camConfig>* dynamicReCfgServer_;
+        spinnaker_sdk_camera_driver::spinnaker_camConfig config_;
+        ros::ServiceServer image_format_srv_;
+
+        // per thread event timeline, written at shutdown and by the dump_trace service
+        ros::ServiceServer dump_trace_srv_;
+        int trace_events_;
+        string trace_file_;
+
+        // held by the acquisition threads while grabbing, a reconfiguration or the hot-plug watchdog
+        // counts itself in pause_acquisition_ and takes it
+        boost::mutex acquisition_mutex_;
+        std::atomic<int> pause_acquisition_;
 
         ros::Publisher acquisition_pub;
         //vector<ros::Publisher> camera_image_pubs;
         vector<ros::Publisher> camera_image_gps_pubs;
         vector<ros::Publisher> image_write_queue_pubs;
         ros::Publisher camera_fps_pub;
+        ros::Publisher frame_set_pub_;
+        vector<ros::Publisher> frame_metadata_pubs_;
         vector<ros::Publisher> benchmark_pubs;
         vector<image_transport::CameraPublisher> camera_image_pubs;
         //vector<ros::Publisher> camera_info_pubs;
@@ -198,6 +436,15 @@ namespace acquisition {
         vector<sensor_msgs::CameraInfoPtr> cam_info_msgs;
         spinnaker_sdk_camera_driver::SpinnakerImageNames mesg;
         boost::mutex queue_mutex_;  
+
+        // frame sets being assembled by the writer threads in run_mt(), keyed by set index
+        struct PendingFrameSet {
+            spinnaker_sdk_camera_driver::SpinnakerImageSetPtr msg;
+            unsigned int received;
+            vector<MemoryTokenPtr> memory;
+        };
+        map<uint64_t, PendingFrameSet> pending_frame_sets_;
+        boost::mutex frame_set_mutex_;
     };
 
 }
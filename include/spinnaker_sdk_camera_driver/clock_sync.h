@@ -0,0 +1,66 @@
+#ifndef CLOCK_SYNC_HEADER
+#define CLOCK_SYNC_HEADER
+
+#include <cstdint>
+#include <deque>
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Maps a camera's device clock (ns since power-on, as in Image::GetTimeStamp())
+     * to host time in ns.
+     *
+     * Samples are pairs of a latched device timestamp and the host time around the
+     * latch; the midpoint of the host times is used and samples whose round trip is
+     * much slower than the fastest one in the window are left out of the fit, as
+     * USB scheduling delay is one-sided. A least squares line over a sliding window of samples gives
+     * offset and drift. Samples may be added from one thread while another maps
+     * timestamps.
+     */
+    class ClockSync {
+
+    public:
+
+        ClockSync(int window = 32);
+
+        // returns false if the sample is left out of the fit as an outlier
+        bool add_sample(int64_t device_ns, int64_t host_before_ns, int64_t host_after_ns);
+
+        bool valid() const;
+        int64_t to_host(int64_t device_ns) const;
+
+        double drift_ppm() const;
+        int64_t offset_ns() const;
+        int num_samples() const;
+
+    private:
+
+        struct Sample {
+            int64_t device_ns;
+            int64_t host_ns;
+            int64_t round_trip_ns;
+        };
+
+        void fit();
+        int64_t max_round_trip_ns() const;
+
+        deque<Sample> samples_;
+        size_t window_;
+
+        // host = host_ref_ + intercept_ + slope_*(device - device_ref_)
+        int64_t device_ref_;
+        int64_t host_ref_;
+        double slope_;
+        double intercept_;
+        bool valid_;
+
+        mutable boost::mutex mutex_;
+
+    };
+
+}
+
+#endif
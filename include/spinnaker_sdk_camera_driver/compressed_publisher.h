@@ -0,0 +1,68 @@
+#ifndef COMPRESSED_PUBLISHER_HEADER
+#define COMPRESSED_PUBLISHER_HEADER
+
+#include "std_include.h"
+#include "sensor_msgs/CompressedImage.h"
+#include "std_msgs/Float64.h"
+#include "trace.h"
+#include "memory_account.h"
+#include <deque>
+
+using namespace cv;
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Publishes JPEG/PNG compressed copies of the camera images, encoded in a
+     * pool of worker threads so encoding never runs on the acquisition or
+     * writer threads. Each camera has at most one frame waiting to be encoded
+     * (a newer frame replaces it) and can be rate limited, so a slow remote
+     * viewer costs CPU but never throttles acquisition.
+     */
+    class CompressedPublisher {
+
+    public:
+
+        ~CompressedPublisher();
+        CompressedPublisher();
+
+        void init(ros::NodeHandle& nh, const vector<string>& cam_names, int num_threads,
+                  string format, int quality, double max_rate);
+        void shutdown();
+
+        // returns false if the frame was skipped by the rate limit, memory is kept until the frame is published
+        bool enqueue(int cam_no, const Mat& frame, const string& encoding, const std_msgs::Header& header,
+                     MemoryTokenPtr memory = MemoryTokenPtr());
+
+    private:
+
+        struct Job {
+            int cam_no;
+            Mat frame;
+            string encoding;
+            std_msgs::Header header;
+            MemoryTokenPtr memory;
+        };
+
+        void worker();
+
+        string format_;
+        vector<int> encode_params_;
+        double min_interval_;
+
+        vector<ros::Publisher> compressed_pubs_;
+        vector<ros::Publisher> encode_time_pubs_;
+        vector<ros::Time> last_enqueued_;
+
+        deque<Job> jobs_;
+        boost::mutex jobs_mutex_;
+        boost::condition_variable jobs_cond_;
+        boost::thread_group workers_;
+        bool running_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef DECIMATION_HEADER
+#define DECIMATION_HEADER
+
+#include <vector>
+
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Decides per camera which output sinks take a grabbed frame, so expensive
+     * sinks only convert and process the frames they actually need. Every sink
+     * takes every n-th frame and optionally at most max_rate frames per second.
+     * select() must be called exactly once per grabbed frame; the state of each
+     * camera is independent so different cameras may be handled by different
+     * threads.
+     */
+    class SinkDecimator {
+
+    public:
+
+        enum Sink {
+            SINK_SAVE = 0,
+            SINK_ROS,
+            SINK_PREVIEW,
+            NUM_SINKS
+        };
+
+        SinkDecimator();
+
+        void init(int num_cams);
+        void set(Sink sink, int cam, int every, double max_rate);
+
+        // bit mask of the sinks that take this frame, t is the grab time in seconds
+        unsigned int select(int cam, double t);
+
+        static bool takes(unsigned int mask, Sink sink) { return mask & (1u << sink); }
+        static const char* name(Sink sink);
+
+    private:
+
+        struct SinkState {
+            int every;
+            double min_interval;
+            int since_last;
+            double last_time;
+        };
+
+        vector< vector<SinkState> > state_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FRAME_OUTPUT_HEADER
+#define FRAME_OUTPUT_HEADER
+
+#include "std_include.h"
+#include <boost/property_tree/ptree.hpp>
+
+using namespace cv;
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Tiles frames side by side into grid, which has to be allocated with the
+     * channels of the preview. Each frame gets 1/frames.size() of the grid's
+     * width; frames of another size or channel count are converted to fit.
+     */
+    void compose_grid(const vector<Mat>& frames, Mat& grid);
+
+    // Stores metadata as JSON in the Exif image description of the saved image filename, throws Exiv2 errors
+    void write_exif_metadata(const string& filename, const boost::property_tree::ptree& metadata);
+
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef FRAME_SET_ASSEMBLER_HEADER
+#define FRAME_SET_ASSEMBLER_HEADER
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+namespace acquisition {
+
+    /** Frames of all cameras belonging to one trigger of the reference (master) camera */
+    template <typename T>
+    struct FrameSet {
+        int64_t frame_id;           // frame ID of the reference camera
+        int64_t stamp_ns;           // timestamp of the reference camera
+        bool complete;
+        vector<bool> present;
+        vector<int64_t> frame_ids;
+        vector<int64_t> stamps_ns;
+        vector<T> frames;
+    };
+
+    /**
+     * Groups frames of several cameras into sets belonging to the same trigger.
+     *
+     * Frames are buffered per camera. Every frame of the reference camera opens a
+     * set, and the other cameras' frames are matched to it by timestamp (within
+     * tolerance_ns, timestamps must be on a common clock) or, when the tolerance
+     * is 0, by frame ID. Each camera's frame ID offset to the reference is
+     * tracked, so a camera that missed a trigger is re-synchronized at its next
+     * frame instead of staying one frame off for the rest of the session.
+     *
+     * A set is emitted as soon as it is complete. It is given up once every
+     * missing camera has delivered a newer frame, or once more than window
+     * reference frames are waiting; given up sets are emitted as partial sets
+     * or dropped. Frames that end up in no set can be collected with
+     * take_dropped(), e.g. to release their buffers.
+     *
+     * Not thread safe, meant to be fed and drained by one acquisition thread.
+     */
+    template <typename T>
+    class FrameSetAssembler {
+
+    public:
+
+        FrameSetAssembler() { init(0, 0, 0, 1, false); }
+
+        void init(int num_cams, int reference_cam, int64_t tolerance_ns, int window, bool emit_partial) {
+            num_cams_ = num_cams;
+            reference_cam_ = reference_cam;
+            tolerance_ns_ = tolerance_ns;
+            window_ = window > 0 ? window : 1;
+            emit_partial_ = emit_partial;
+            pending_.assign(num_cams, deque<Frame>());
+            id_offsets_.assign(num_cams, 0);
+            rejoining_.assign(num_cams, false);
+            dropped_.clear();
+            dropped_cams_.clear();
+            complete_sets_ = partial_sets_ = dropped_frames_ = resyncs_ = 0;
+        }
+
+        void add(int cam, int64_t frame_id, int64_t stamp_ns, const T& frame) {
+            Frame f;
+            f.frame_id = frame_id;
+            f.stamp_ns = stamp_ns;
+            f.frame = frame;
+            pending_[cam].push_back(f);
+        }
+
+        /** Pops the next finished set, returns false if none is ready yet */
+        bool next(FrameSet<T>& set) {
+            deque<Frame>& reference = pending_[reference_cam_];
+            while (!reference.empty()) {
+                const Frame& ref = reference.front();
+                vector<int> matches(num_cams_, -1);
+                bool complete = true;
+                bool may_arrive = false;
+
+                for (int c = 0; c < num_cams_; c++) {
+                    if (c == reference_cam_)
+                        continue;
+                    matches[c] = find_match(c, ref);
+                    if (matches[c] < 0) {
+                        complete = false;
+                        may_arrive = may_arrive || !has_later_frame(c, ref);
+                    }
+                }
+
+                if (!complete && may_arrive && (int)reference.size() <= window_)
+                    return false;
+
+                if (complete || emit_partial_) {
+                    build_set(set, matches, complete);
+                    if (complete) complete_sets_++;
+                    else partial_sets_++;
+                    return true;
+                }
+
+                // the set was given up and is not wanted partially
+                FrameSet<T> discarded;
+                build_set(discarded, matches, false);
+                for (int c = 0; c < num_cams_; c++)
+                    if (discarded.present[c]) {
+                        drop(c, discarded.frames[c]);
+                    }
+            }
+            return false;
+        }
+
+        /** Forgets the frames of a camera that was reconnected, its frame IDs start over */
+        void rejoin(int cam) {
+            while (!pending_[cam].empty()) {
+                drop(cam, pending_[cam].front().frame);
+                pending_[cam].pop_front();
+            }
+            rejoining_[cam] = true;
+        }
+
+        /** Gives up all frames still waiting for their set, e.g. when the cameras are restarted */
+        void flush() {
+            for (int c = 0; c < num_cams_; c++)
+                while (!pending_[c].empty()) {
+                    drop(c, pending_[c].front().frame);
+                    pending_[c].pop_front();
+                }
+        }
+
+        /** Moves the frames that were dropped since the last call into frames */
+        void take_dropped(vector<T>& frames) {
+            frames.insert(frames.end(), dropped_.begin(), dropped_.end());
+            dropped_.clear();
+            dropped_cams_.clear();
+        }
+
+        /** Same as take_dropped(frames), with the camera of each frame in cams */
+        void take_dropped(vector<T>& frames, vector<int>& cams) {
+            cams.insert(cams.end(), dropped_cams_.begin(), dropped_cams_.end());
+            take_dropped(frames);
+        }
+
+        uint64_t complete_sets() const { return complete_sets_; }
+        uint64_t partial_sets() const { return partial_sets_; }
+        uint64_t dropped_frames() const { return dropped_frames_; }
+        uint64_t resyncs() const { return resyncs_; }
+
+    private:
+
+        struct Frame {
+            int64_t frame_id;
+            int64_t stamp_ns;
+            T frame;
+        };
+
+        void drop(int cam, const T& frame) {
+            dropped_.push_back(frame);
+            dropped_cams_.push_back(cam);
+            dropped_frames_++;
+        }
+
+        // index of the frame of cam matching the reference frame, -1 if none
+        int find_match(int cam, const Frame& ref) {
+            const deque<Frame>& frames = pending_[cam];
+            if (rejoining_[cam] && !frames.empty()) {
+                // without timestamps the first frame after a reconnect has to be taken as the one of the newest
+                // reference frame, the sets still waiting for the camera are given up
+                if (tolerance_ns_ <= 0) {
+                    id_offsets_[cam] = frames.front().frame_id - pending_[reference_cam_].back().frame_id;
+                    resyncs_++;
+                }
+                rejoining_[cam] = false;
+            }
+            int64_t expected_id = ref.frame_id + id_offsets_[cam];
+
+            if (tolerance_ns_ <= 0) {
+                for (int k = 0; k < (int)frames.size(); k++)
+                    if (frames[k].frame_id == expected_id)
+                        return k;
+                return -1;
+            }
+
+            int best = -1;
+            int64_t best_dt = 0;
+            for (int k = 0; k < (int)frames.size(); k++) {
+                int64_t dt = llabs(frames[k].stamp_ns - ref.stamp_ns);
+                if (dt > tolerance_ns_)
+                    continue;
+                // the expected frame ID wins over a slightly closer timestamp
+                if (frames[k].frame_id == expected_id) {
+                    best = k;
+                    break;
+                }
+                if (best < 0 || dt < best_dt) {
+                    best = k;
+                    best_dt = dt;
+                }
+            }
+            if (best >= 0 && frames[best].frame_id != expected_id) {
+                id_offsets_[cam] = frames[best].frame_id - ref.frame_id;
+                resyncs_++;
+            }
+            return best;
+        }
+
+        // true if cam already delivered a frame that was taken after the reference frame
+        bool has_later_frame(int cam, const Frame& ref) const {
+            const deque<Frame>& frames = pending_[cam];
+            for (int k = 0; k < (int)frames.size(); k++) {
+                if (tolerance_ns_ > 0 && frames[k].stamp_ns > ref.stamp_ns + tolerance_ns_)
+                    return true;
+                if (tolerance_ns_ <= 0 && frames[k].frame_id > ref.frame_id + id_offsets_[cam])
+                    return true;
+            }
+            return false;
+        }
+
+        // moves the reference frame and its matches into set, frames older than a match are dropped
+        void build_set(FrameSet<T>& set, const vector<int>& matches, bool complete) {
+            deque<Frame>& reference = pending_[reference_cam_];
+            set.frame_id = reference.front().frame_id;
+            set.stamp_ns = reference.front().stamp_ns;
+            set.complete = complete;
+            set.present.assign(num_cams_, false);
+            set.frame_ids.assign(num_cams_, 0);
+            set.stamps_ns.assign(num_cams_, 0);
+            set.frames.assign(num_cams_, T());
+
+            for (int c = 0; c < num_cams_; c++) {
+                int k = c == reference_cam_ ? 0 : matches[c];
+                if (k < 0) {
+                    // frames of a camera that are older than the reference can never be matched anymore
+                    drop_older(c, set.stamp_ns, set.frame_id);
+                    continue;
+                }
+                deque<Frame>& frames = pending_[c];
+                for (int j = 0; j < k; j++) {
+                    drop(c, frames.front().frame);
+                    frames.pop_front();
+                }
+                set.present[c] = true;
+                set.frame_ids[c] = frames.front().frame_id;
+                set.stamps_ns[c] = frames.front().stamp_ns;
+                set.frames[c] = frames.front().frame;
+                frames.pop_front();
+            }
+        }
+
+        void drop_older(int cam, int64_t stamp_ns, int64_t frame_id) {
+            deque<Frame>& frames = pending_[cam];
+            while (!frames.empty() &&
+                   ((tolerance_ns_ > 0 && frames.front().stamp_ns < stamp_ns - tolerance_ns_) ||
+                    (tolerance_ns_ <= 0 && frames.front().frame_id < frame_id + id_offsets_[cam]))) {
+                drop(cam, frames.front().frame);
+                frames.pop_front();
+            }
+        }
+
+        int num_cams_;
+        int reference_cam_;
+        int64_t tolerance_ns_;
+        int window_;
+        bool emit_partial_;
+
+        vector< deque<Frame> > pending_;
+        vector<int64_t> id_offsets_;
+        vector<bool> rejoining_;
+        vector<T> dropped_;
+        vector<int> dropped_cams_;
+
+        uint64_t complete_sets_;
+        uint64_t partial_sets_;
+        uint64_t dropped_frames_;
+        uint64_t resyncs_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef FRAME_SOURCE_HEADER
+#define FRAME_SOURCE_HEADER
+
+#include "std_include.h"
+#include <atomic>
+#include <random>
+
+using namespace Spinnaker;
+using namespace cv;
+using namespace std;
+
+namespace acquisition {
+
+    // one image delivered by a FrameSource
+    struct SourceFrame {
+        Mat image;                  // 1 channel for Mono8 and BayerRG8, 3 for BGR8
+        PixelFormatEnums format;
+        int64_t timestamp_ns;       // on the device clock of the source
+        int64_t frame_id;
+        double exposure_time_us;
+        double gain_db;
+    };
+
+    /**
+     * Produces the images of a camera that has no Spinnaker device behind it,
+     * so the acquisition, save and publish paths can run and be profiled on a
+     * machine without cameras.
+     *
+     * A Camera constructed from a source hands it the settings the driver
+     * makes, under the GenICam feature names of a real camera (Width,
+     * BinningHorizontal, PixelFormat, TriggerMode, ...). A source emulates the
+     * features it knows and keeps the others without effect.
+     */
+    class FrameSource {
+
+    public:
+
+        virtual ~FrameSource() {}
+
+        virtual string id() = 0;
+        virtual string model() = 0;
+
+        virtual void init() = 0;
+        virtual void deinit() = 0;
+        virtual bool is_initialized() = 0;
+
+        virtual void set_int(const string& feature, int64_t value) = 0;
+        virtual void set_float(const string& feature, double value) = 0;
+        virtual void set_enum(const string& feature, const string& value) = 0;
+        virtual void set_bool(const string& feature, bool value) = 0;
+        virtual int64_t get_int_max(const string& feature) = 0;
+        virtual double get_float_max(const string& feature) = 0;
+        virtual int64_t payload_size() = 0;
+
+        virtual void begin_acquisition() = 0;
+        virtual void end_acquisition() = 0;
+        virtual bool is_streaming() = 0;
+        virtual void trigger() = 0;
+        // waits up to timeout_ms for the next image, false if none came
+        virtual bool next_frame(SourceFrame& frame, uint64_t timeout_ms) = 0;
+        virtual int64_t device_time_ns() = 0;
+        // transport layer stream counter (StreamLostFrameCount, ...) since begin_acquisition(), -1 if not emulated
+        virtual int64_t stream_counter(const string& name) { return -1; }
+
+    };
+
+    /**
+     * Trigger signal shared by the simulated cameras of an array, standing in
+     * for the master's strobe output wired to the trigger inputs of the
+     * slaves. Its epoch is the zero of the device clocks of all sources on it.
+     *
+     * While no source drives it and a rate is set, the line triggers itself at
+     * that rate, like an external trigger generator or a free running master.
+     */
+    class SimulatedTriggerLine {
+
+    public:
+
+        SimulatedTriggerLine(double rate = 0, ros::WallTime epoch = ros::WallTime::now());
+
+        ros::WallTime epoch() { return epoch_; }
+        int64_t now_ns();
+        void set_rate(double rate);
+        void attach_driver();
+        void detach_driver();
+        void fire(int64_t time_ns);
+        uint64_t count();
+
+        // waits until deadline_ns for a trigger after the seen ones, counts it as seen and returns its time
+        bool wait(uint64_t& seen, int64_t& time_ns, int64_t deadline_ns);
+
+    private:
+
+        static const int HISTORY = 64;
+
+        boost::mutex mutex_;
+        boost::condition_variable cond_;
+        ros::WallTime epoch_;
+        int64_t period_ns_;
+        int64_t last_tick_ns_;
+        int drivers_;
+        uint64_t count_;
+        int64_t times_ns_[HISTORY];
+
+    };
+
+    /**
+     * Source of generated test patterns in the configured size and pixel
+     * format (Mono8, or BayerRG8 for color cameras).
+     *
+     * Triggering follows the camera configuration: a software triggered
+     * camera exposes on trigger(), a camera triggered by a line waits for the
+     * shared trigger line, and a free running one exposes at rate fps, or the
+     * AcquisitionFrameRate once it is enabled. A camera with a line in output
+     * mode drives the shared line, as the master does for the slaves.
+     *
+     * Each image is delayed by a random jitter of up to jitter_ms, and drops
+     * is a pattern of frames that are lost (e.g. "1111111110" loses every
+     * 10th frame), their frame IDs are skipped as on a real camera.
+     */
+    class SyntheticSource : public FrameSource {
+
+    public:
+
+        SyntheticSource(const string& id, std::shared_ptr<SimulatedTriggerLine> line, int sensor_width,
+                        int sensor_height, double rate, double jitter_ms, const string& drops);
+        virtual ~SyntheticSource() {}
+
+        virtual string id() { return id_; }
+        virtual string model() { return "Synthetic"; }
+
+        virtual void init() { initialized_ = true; }
+        virtual void deinit() { initialized_ = false; }
+        virtual bool is_initialized() { return initialized_; }
+
+        virtual void set_int(const string& feature, int64_t value);
+        virtual void set_float(const string& feature, double value);
+        virtual void set_enum(const string& feature, const string& value);
+        virtual void set_bool(const string& feature, bool value);
+        virtual int64_t get_int_max(const string& feature);
+        virtual double get_float_max(const string& feature);
+        virtual int64_t payload_size();
+
+        virtual void begin_acquisition();
+        virtual void end_acquisition();
+        virtual bool is_streaming() { return streaming_; }
+        virtual void trigger();
+        virtual bool next_frame(SourceFrame& frame, uint64_t timeout_ms);
+        virtual int64_t device_time_ns() { return line_->now_ns(); }
+        virtual int64_t stream_counter(const string& name);
+
+    protected:
+
+        // fills frames_ with the images to cycle through in the configured size and format
+        virtual void prepare_frames(int width, int height, PixelFormatEnums format);
+
+        int64_t int_value(const string& feature, int64_t default_value);
+        string enum_value(const string& feature, const string& default_value);
+        double frame_rate();
+        void update_rate();
+
+        string id_;
+        int sensor_width_;
+        int sensor_height_;
+        vector<Mat> frames_;
+        PixelFormatEnums format_;
+
+    private:
+
+        std::shared_ptr<SimulatedTriggerLine> line_;
+        // software triggers, and the frame clock of a free running camera that drives no line
+        SimulatedTriggerLine own_line_;
+        SimulatedTriggerLine* input_;
+        bool software_trigger_;
+        bool free_running_;
+        bool strobe_;
+
+        map<string, int64_t> ints_;
+        map<string, double> floats_;
+        map<string, string> enums_;
+        map<string, bool> bools_;
+
+        double rate_;
+        int64_t jitter_ns_;
+        string drops_;
+        std::mt19937 random_;
+        std::atomic<double> exposure_time_us_;
+        std::atomic<double> gain_db_;
+
+        bool initialized_;
+        std::atomic<bool> streaming_;
+        uint64_t seen_;
+        int64_t next_id_;
+        std::atomic<int64_t> lost_frames_;
+
+    };
+
+    /**
+     * Source that plays back images saved by the driver (one directory per
+     * camera, files in name order, looped), timed like a SyntheticSource.
+     * The images are delivered as recorded: 1 channel images as Mono8, color
+     * images as BGR8, the size and pixel format settings are ignored.
+     */
+    class ReplaySource : public SyntheticSource {
+
+    public:
+
+        ReplaySource(const string& id, const string& path, std::shared_ptr<SimulatedTriggerLine> line,
+                     double rate, double jitter_ms, const string& drops);
+
+        virtual string model() { return "Replay"; }
+        virtual int64_t payload_size();
+        int num_frames() { return frames_.size(); }
+
+    protected:
+
+        virtual void prepare_frames(int width, int height, PixelFormatEnums format) {}
+
+    };
+
+}
+
+#endif
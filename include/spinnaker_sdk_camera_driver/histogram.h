@@ -0,0 +1,137 @@
+#ifndef HISTOGRAM_HEADER
+#define HISTOGRAM_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace acquisition {
+
+    /** Percentile summary of a histogram, values in the unit they were recorded in */
+    struct HistogramSummary {
+        uint64_t count;
+        double min;
+        double mean;
+        double p50;
+        double p90;
+        double p99;
+        double max;
+    };
+
+    /**
+     * HDR-style log-linear histogram of non-negative integer values.
+     *
+     * Every power of two range is split into 16 linear sub-buckets, which keeps
+     * the relative error of reported percentiles below ~6% over the full 64 bit
+     * range in under 8 KB. record() only does relaxed atomic increments so it can
+     * be called from any number of threads without locking; summarize() may run
+     * concurrently and sees a slightly inconsistent but usable state.
+     */
+    class Histogram {
+
+    public:
+
+        static const int SUB_BUCKET_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const int NUM_BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+        Histogram() { reset(); }
+
+        void record(uint64_t value) {
+            counts_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+
+            uint64_t current = max_.load(std::memory_order_relaxed);
+            while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed));
+            current = min_.load(std::memory_order_relaxed);
+            while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed));
+        }
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+        void reset() {
+            for (int i = 0; i < NUM_BUCKETS; i++)
+                counts_[i].store(0, std::memory_order_relaxed);
+            count_.store(0, std::memory_order_relaxed);
+            sum_.store(0, std::memory_order_relaxed);
+            max_.store(0, std::memory_order_relaxed);
+            min_.store(UINT64_MAX, std::memory_order_relaxed);
+        }
+
+        /** Percentile summary scaled by scale (e.g. 1e-3 to report us as ms); resets the histogram if asked to */
+        HistogramSummary summarize(double scale = 1.0, bool reset_after = false) {
+            std::vector<uint64_t> counts(NUM_BUCKETS);
+            uint64_t total = 0;
+            for (int i = 0; i < NUM_BUCKETS; i++) {
+                counts[i] = reset_after ? counts_[i].exchange(0, std::memory_order_relaxed)
+                                        : counts_[i].load(std::memory_order_relaxed);
+                total += counts[i];
+            }
+            uint64_t sum = reset_after ? sum_.exchange(0, std::memory_order_relaxed) : sum_.load(std::memory_order_relaxed);
+            uint64_t max = reset_after ? max_.exchange(0, std::memory_order_relaxed) : max_.load(std::memory_order_relaxed);
+            uint64_t min = reset_after ? min_.exchange(UINT64_MAX, std::memory_order_relaxed) : min_.load(std::memory_order_relaxed);
+            if (reset_after)
+                count_.fetch_sub(total, std::memory_order_relaxed);
+
+            HistogramSummary summary;
+            summary.count = total;
+            if (total == 0) {
+                summary.min = summary.mean = summary.p50 = summary.p90 = summary.p99 = summary.max = 0;
+                return summary;
+            }
+            summary.min = min * scale;
+            summary.max = max * scale;
+            summary.mean = (double(sum) / total) * scale;
+            summary.p50 = std::min(double(max), percentile(counts, total, 50.0)) * scale;
+            summary.p90 = std::min(double(max), percentile(counts, total, 90.0)) * scale;
+            summary.p99 = std::min(double(max), percentile(counts, total, 99.0)) * scale;
+            return summary;
+        }
+
+        static int bucket_index(uint64_t value) {
+            if (value < (uint64_t)SUB_BUCKETS)
+                return (int)value;
+            int msb = 63 - __builtin_clzll(value);
+            int shift = msb - SUB_BUCKET_BITS;
+            int sub_bucket = (int)(value >> shift) - SUB_BUCKETS;
+            return SUB_BUCKETS + shift * SUB_BUCKETS + sub_bucket;
+        }
+
+        /** Midpoint of the value range covered by a bucket */
+        static double bucket_value(int index) {
+            if (index < SUB_BUCKETS)
+                return index;
+            int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+            int sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+            double width = std::ldexp(1.0, shift);
+            return (SUB_BUCKETS + sub_bucket) * width + width / 2.0;
+        }
+
+    private:
+
+        static double percentile(const std::vector<uint64_t>& counts, uint64_t total, double pct) {
+            uint64_t target = (uint64_t)std::ceil(pct / 100.0 * total);
+            if (target == 0) target = 1;
+            uint64_t cumulative = 0;
+            for (int i = 0; i < NUM_BUCKETS; i++) {
+                cumulative += counts[i];
+                if (cumulative >= target)
+                    return bucket_value(i);
+            }
+            return bucket_value(NUM_BUCKETS - 1);
+        }
+
+        std::atomic<uint64_t> counts_[NUM_BUCKETS];
+        std::atomic<uint64_t> count_;
+        std::atomic<uint64_t> sum_;
+        std::atomic<uint64_t> max_;
+        std::atomic<uint64_t> min_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef MEMORY_ACCOUNT_HEADER
+#define MEMORY_ACCOUNT_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace acquisition {
+
+    class MemoryAccount;
+
+    // Bytes of one image held in one stage, counted for as long as the token lives
+    class MemoryToken {
+
+    public:
+
+        MemoryToken(MemoryAccount* account, int cam, int stage, int64_t bytes);
+        ~MemoryToken();
+
+    private:
+
+        MemoryToken(const MemoryToken&);
+        MemoryToken& operator=(const MemoryToken&);
+
+        MemoryAccount* account_;
+        int cam_;
+        int stage_;
+        int64_t bytes_;
+
+    };
+
+    typedef std::shared_ptr<MemoryToken> MemoryTokenPtr;
+
+    /**
+     * Image memory the driver holds, per camera and per stage of the pipeline.
+     *
+     * Whoever keeps an image (a queue entry, a pending frame set, ...) keeps
+     * the token returned by hold() along with it; copies of the entry share
+     * the token, and the bytes are given back when the last copy is gone.
+     * Moving an image on to the next stage is assigning the token of the new
+     * stage. Counting is lock free, so it can be done from any thread.
+     *
+     * Besides the bytes currently held, the account keeps the high-water marks
+     * since the last take_peak() and since init(), per camera and stage, per
+     * camera (stage total()) and for all cameras (camera all()).
+     */
+    class MemoryAccount {
+
+    public:
+
+        MemoryAccount() { init(0, 0); }
+
+        // not thread safe, call before any image is held
+        void init(int num_cams, int num_stages);
+
+        MemoryTokenPtr hold(int cam, int stage, int64_t bytes) {
+            return MemoryTokenPtr(new MemoryToken(this, cam, stage, bytes));
+        }
+
+        int all() const { return num_cams_; }
+        int total() const { return num_stages_; }
+
+        int64_t bytes(int cam, int stage) const { return cell(cam, stage).bytes.load(std::memory_order_relaxed); }
+        int64_t max_bytes(int cam, int stage) const { return cell(cam, stage).max.load(std::memory_order_relaxed); }
+        // high-water mark since the last call, starts over at the bytes held now
+        int64_t take_peak(int cam, int stage);
+
+    private:
+
+        friend class MemoryToken;
+
+        struct Cell {
+            std::atomic<int64_t> bytes;
+            std::atomic<int64_t> peak;
+            std::atomic<int64_t> max;
+        };
+
+        void add(int cam, int stage, int64_t bytes);
+        void add_to_cell(Cell& cell, int64_t bytes);
+        Cell& cell(int cam, int stage) { return cells_[cam * (num_stages_ + 1) + stage]; }
+        const Cell& cell(int cam, int stage) const { return cells_[cam * (num_stages_ + 1) + stage]; }
+
+        int num_cams_;
+        int num_stages_;
+        std::unique_ptr<Cell[]> cells_;
+
+    };
+
+}
+
+#endif
@@ -37,6 +37,7 @@
 #include <cstdlib>
 
 #include <queue> 
+#include <map>
 #include <boost/thread.hpp>
 
 #include <unistd.h>
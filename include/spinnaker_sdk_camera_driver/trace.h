@@ -0,0 +1,74 @@
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Timeline of what the threads of the driver are doing, to find the stalls
+     * of a session.
+     *
+     * Every thread records its events (name, camera, frame ID, begin and
+     * duration) into a ring buffer of its own that keeps the latest
+     * events_per_thread of them, so threads never wait for each other to
+     * record. While tracing is off, an event costs one relaxed atomic load.
+     * write_trace() dumps the buffers of all threads, including those that
+     * ended, in the Chrome trace event format (chrome://tracing or
+     * ui.perfetto.dev).
+     */
+    void enable_tracing(size_t events_per_thread);
+    void disable_tracing();
+
+    // names the calling thread in the trace
+    void trace_thread_name(const string& name);
+
+    // records an event of the calling thread, name has to outlive the trace (a string literal)
+    void trace_event(const char* name, int cam, int64_t frame_id, int64_t begin_ns, int64_t end_ns);
+
+    // false if the file could not be written
+    bool write_trace(const string& filename);
+
+    extern std::atomic<bool> tracing_on;
+
+    inline bool tracing_enabled() { return tracing_on.load(std::memory_order_relaxed); }
+
+    inline int64_t trace_now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Records the time from its construction until end() or its destruction, cam -1 for the whole array
+    class TraceScope {
+
+    public:
+
+        TraceScope(const char* name, int cam = -1, int64_t frame_id = -1)
+            : name_(name), cam_(cam), frame_id_(frame_id), begin_ns_(tracing_enabled() ? trace_now_ns() : -1) {}
+        ~TraceScope() { end(); }
+
+        // for events whose frame is only known at their end, e.g. a grab
+        void set_frame_id(int64_t frame_id) { frame_id_ = frame_id; }
+
+        void end() {
+            if (begin_ns_ >= 0)
+                trace_event(name_, cam_, frame_id_, begin_ns_, trace_now_ns());
+            begin_ns_ = -1;
+        }
+
+    private:
+
+        const char* name_;
+        int cam_;
+        int64_t frame_id_;
+        int64_t begin_ns_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef TRIGGER_QUEUE_HEADER
+#define TRIGGER_QUEUE_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "msgs_and_srvs/ImageTriggerMsg.h"
+
+using namespace std;
+
+namespace acquisition {
+
+    /**
+     * Time ordered buffer of trigger messages (GPS position etc.) waiting for
+     * the frames they were sent for.
+     *
+     * Messages are pushed with their receive time by the subscriber callback and
+     * matched by the acquisition thread to the timestamp of each frame set: the
+     * message received closest to the frame within window_ns belongs to it,
+     * older messages are discarded as unmatched. A jump in image_number between
+     * consecutively matched messages counts as a sequence gap.
+     *
+     * Single producer, single consumer ring buffer; neither side takes a lock,
+     * so a high trigger rate can't stall the acquisition thread. The counters
+     * may be read from any thread.
+     */
+    class TriggerQueue {
+
+    public:
+
+        TriggerQueue(size_t capacity = 256);
+
+        void set_window(int64_t window_ns) { window_ns_ = window_ns; }
+
+        // producer side, returns false if the buffer is full and msg was dropped
+        bool push(const msgs_and_srvs::ImageTriggerMsg& msg, int64_t receive_ns);
+
+        // consumer side, returns false if no message belongs to the frame taken at frame_ns
+        bool match(int64_t frame_ns, msgs_and_srvs::ImageTriggerMsg& msg);
+
+        uint64_t received() const { return received_.load(memory_order_relaxed); }
+        uint64_t matched() const { return matched_.load(memory_order_relaxed); }
+        uint64_t unmatched_frames() const { return unmatched_frames_.load(memory_order_relaxed); }
+        uint64_t unmatched_triggers() const { return unmatched_triggers_.load(memory_order_relaxed); }
+        uint64_t sequence_gaps() const { return sequence_gaps_.load(memory_order_relaxed); }
+        uint64_t overflows() const { return overflows_.load(memory_order_relaxed); }
+
+    private:
+
+        struct Entry {
+            msgs_and_srvs::ImageTriggerMsg msg;
+            int64_t receive_ns;
+        };
+
+        void pop();
+
+        vector<Entry> ring_;
+        // head_ is only written by the producer, tail_ only by the consumer
+        atomic<size_t> head_;
+        atomic<size_t> tail_;
+        int64_t window_ns_;
+
+        bool have_last_;
+        int64_t last_image_number_;
+
+        atomic<uint64_t> received_;
+        atomic<uint64_t> matched_;
+        atomic<uint64_t> unmatched_frames_;
+        atomic<uint64_t> unmatched_triggers_;
+        atomic<uint64_t> sequence_gaps_;
+        atomic<uint64_t> overflows_;
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,301 @@
+#!/usr/bin/env python
+"""
+Headless end to end throughput check of the acquisition nodelet.
+
+Launches launch/throughput_harness.launch on synthetic cameras for every
+combination of camera count and resolution, saving to a temporary directory
+and publishing to the benchmark subscriber nodelet. Each run lasts a fixed
+duration after a warm up. The achieved fps, the frames lost on the way and
+the per stage latencies are collected from the driver's StageStats and
+/diagnostics and the subscriber's SubscriberBenchmark messages.
+
+The results go to a JSON file. Runs are compared against stored baselines of
+the same name. The exit status is 1 if any run regressed, so the script can
+gate a deployment.
+
+    rosrun spinnaker_sdk_camera_driver throughput_harness.py --cameras 1 4 --resolutions 1440x1080
+    rosrun spinnaker_sdk_camera_driver throughput_harness.py --update-baselines
+"""
+
+from __future__ import print_function
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+import rosgraph
+import rospkg
+import rospy
+from diagnostic_msgs.msg import DiagnosticArray
+from spinnaker_sdk_camera_driver.msg import StageStats, SubscriberBenchmark
+
+PACKAGE = 'spinnaker_sdk_camera_driver'
+LOSS_COUNTERS = ['incomplete', 'skipped_ids', 'timeouts', 'queue_drops', 'save_failures']
+FIRST_CAM_ID = 1001
+
+
+class RunRecorder(object):
+    """Collects the reports of the driver and the subscriber while recording is on."""
+
+    def __init__(self, cam_ids):
+        self.recording = False
+        self.fps = dict((cam, []) for cam in cam_ids)
+        self.queue_size = dict((cam, 0) for cam in cam_ids)
+        self.stages = {}
+        self.memory_peak = dict((cam, 0) for cam in cam_ids + ['all'])
+        self.first_counts = {}
+        self.last_counts = {}
+        self.received_fps = {}
+        self.received_dropped = 0
+        self.latency_p99 = 0.0
+        self.subscribers = [rospy.Subscriber('/camera_array/%s/stage_stats' % cam, StageStats, self.on_stage_stats)
+                            for cam in cam_ids]
+        self.subscribers.append(rospy.Subscriber('/camera_array/stage_stats', StageStats, self.on_stage_stats))
+        self.subscribers.append(rospy.Subscriber('/diagnostics', DiagnosticArray, self.on_diagnostics))
+        self.subscribers.append(rospy.Subscriber('/subscriber_benchmark/benchmark', SubscriberBenchmark,
+                                                 self.on_subscriber_benchmark))
+
+    def close(self):
+        for subscriber in self.subscribers:
+            subscriber.unregister()
+
+    def on_stage_stats(self, msg):
+        if not self.recording:
+            return
+        if msg.camera in self.fps:
+            self.fps[msg.camera].append(msg.fps)
+            self.queue_size[msg.camera] = max(self.queue_size[msg.camera], msg.queue_size)
+        else:
+            # the whole array reports at once outside max_rate_save
+            for cam in self.fps:
+                self.fps[cam].append(msg.fps)
+        for stage in msg.stages:
+            times = self.stages.setdefault(stage.name, {'p50': [], 'p99': [], 'max': 0.0})
+            times['p50'].append(stage.p50)
+            times['p99'].append(stage.p99)
+            times['max'] = max(times['max'], stage.max)
+        for memory in msg.memory:
+            if memory.stage == 'total':
+                self.memory_peak[memory.camera] = max(self.memory_peak[memory.camera], memory.peak_bytes)
+
+    def on_diagnostics(self, msg):
+        for status in msg.status:
+            if not status.name.startswith('spinnaker_camera: '):
+                continue
+            values = dict((value.key, value.value) for value in status.values)
+            counts = dict((key, int(values.get(key, 0))) for key in LOSS_COUNTERS + ['frames'])
+            if not self.recording:
+                self.first_counts[status.name] = counts
+            else:
+                self.first_counts.setdefault(status.name, counts)
+                self.last_counts[status.name] = counts
+
+    def on_subscriber_benchmark(self, msg):
+        if not self.recording:
+            return
+        self.received_fps.setdefault(msg.topic, []).append(msg.fps)
+        self.received_dropped += msg.dropped
+        self.latency_p99 = max(self.latency_p99, msg.latency.p99)
+
+    def summary(self):
+        fps = dict((cam, sum(values) / len(values) if values else 0.0) for cam, values in self.fps.items())
+        drops = dict((key, 0) for key in LOSS_COUNTERS)
+        frames = 0
+        for name, last in self.last_counts.items():
+            first = self.first_counts[name]
+            frames += last['frames'] - first['frames']
+            for key in LOSS_COUNTERS:
+                drops[key] += last[key] - first[key]
+        # the array wide peak is only reported outside max_rate_save, otherwise the per camera peaks add up
+        memory_peak = self.memory_peak['all'] or sum(peak for cam, peak in self.memory_peak.items() if cam != 'all')
+        received_fps = [sum(values) / len(values) for values in self.received_fps.values()]
+        stages = {}
+        for name, times in self.stages.items():
+            stages[name] = {'p50_ms': sum(times['p50']) / len(times['p50']),
+                            'p99_ms': max(times['p99']),
+                            'max_ms': times['max']}
+        return {
+            'fps_per_camera': fps,
+            'fps_min': min(fps.values()) if fps else 0.0,
+            'frames': frames,
+            'drops': drops,
+            'drops_total': sum(drops.values()),
+            'max_queue_size': max(self.queue_size.values()) if self.queue_size else 0,
+            'stages': stages,
+            'memory_peak_bytes': memory_peak,
+            'received_fps_min': min(received_fps) if received_fps else 0.0,
+            'received_dropped': self.received_dropped,
+            'received_latency_p99_ms': self.latency_p99,
+        }
+
+
+def run_name(num_cams, resolution):
+    return '%dcam_%s' % (num_cams, resolution)
+
+
+def count_files(path):
+    return sum(len(files) for _, _, files in os.walk(path))
+
+
+def run(num_cams, resolution, args):
+    width, height = [int(v) for v in resolution.split('x')]
+    cam_ids = [str(FIRST_CAM_ID + k) for k in range(num_cams)]
+    save_path = tempfile.mkdtemp(prefix='throughput_harness_')
+    name = run_name(num_cams, resolution)
+    print('%s: %d s at %.1f fps, saving to %s' % (name, args.duration, args.fps, save_path))
+
+    command = ['roslaunch', PACKAGE, 'throughput_harness.launch',
+               'cam_ids:=[%s]' % ', '.join(cam_ids), 'master_cam:=%s' % cam_ids[0],
+               'width:=%d' % width, 'height:=%d' % height, 'fps:=%s' % args.fps,
+               'color:=%s' % str(args.color).lower(), 'save_type:=%s' % args.save_type,
+               'save_path:=%s' % save_path, 'max_rate_save:=%s' % str(not args.soft_trigger).lower()]
+    recorder = RunRecorder(cam_ids)
+    launch = subprocess.Popen(command, stdout=open(os.devnull, 'w'), stderr=subprocess.STDOUT)
+    error = None
+    try:
+        deadline = time.time() + args.warmup
+        while time.time() < deadline and launch.poll() is None:
+            time.sleep(0.1)
+        recorder.recording = True
+        deadline = time.time() + args.duration
+        while time.time() < deadline and launch.poll() is None:
+            time.sleep(0.1)
+        recorder.recording = False
+        if launch.poll() is not None:
+            error = 'roslaunch exited with %d' % launch.returncode
+    finally:
+        if launch.poll() is None:
+            launch.send_signal(signal.SIGINT)
+            deadline = time.time() + 15
+            while time.time() < deadline and launch.poll() is None:
+                time.sleep(0.1)
+            if launch.poll() is None:
+                launch.kill()
+        recorder.close()
+
+    result = recorder.summary()
+    result.update({'name': name, 'cameras': num_cams, 'width': width, 'height': height, 'target_fps': args.fps,
+                   'saved_files': count_files(save_path)})
+    if error:
+        result['error'] = error
+    if not args.keep_images:
+        shutil.rmtree(save_path, ignore_errors=True)
+    print('%s: %.1f fps (min of cameras), %d drops, %d files saved' %
+          (name, result['fps_min'], result['drops_total'], result['saved_files']))
+    return result
+
+
+def compare(result, baseline, args):
+    """Returns the regressions of a run against its baseline."""
+    regressions = []
+    if 'error' in result:
+        regressions.append('%s: %s' % (result['name'], result['error']))
+    if result['fps_min'] < baseline['fps_min'] * (1 - args.fps_tolerance):
+        regressions.append('%s: %.1f fps, baseline %.1f' % (result['name'], result['fps_min'], baseline['fps_min']))
+    if result['drops_total'] > baseline['drops_total'] + args.drop_allowance:
+        regressions.append('%s: %d frames lost, baseline %d' % (result['name'], result['drops_total'],
+                                                                baseline['drops_total']))
+    for stage, times in baseline['stages'].items():
+        if stage not in result['stages']:
+            continue
+        # small times are noisy, a stage has to be slower by latency_tolerance and by at least 1 ms
+        p99 = result['stages'][stage]['p99_ms']
+        if p99 > times['p99_ms'] * (1 + args.latency_tolerance) and p99 > times['p99_ms'] + 1.0:
+            regressions.append('%s: %s p99 %.2f ms, baseline %.2f ms' % (result['name'], stage, p99, times['p99_ms']))
+    return regressions
+
+
+def ensure_master():
+    """Starts a roscore for all runs unless one is running, returns its process."""
+    if rosgraph.is_master_online():
+        return None
+    core = subprocess.Popen(['roscore'], stdout=open(os.devnull, 'w'), stderr=subprocess.STDOUT)
+    deadline = time.time() + 20
+    while not rosgraph.is_master_online():
+        if time.time() > deadline or core.poll() is not None:
+            sys.exit('Could not start roscore')
+        time.sleep(0.2)
+    return core
+
+
+def main():
+    default_baselines = os.path.join(rospkg.RosPack().get_path(PACKAGE), 'benchmark', 'throughput_baselines.json')
+    parser = argparse.ArgumentParser(description=__doc__.strip().split('\n')[0])
+    parser.add_argument('--cameras', type=int, nargs='+', default=[1, 4], help='camera counts to run')
+    parser.add_argument('--resolutions', nargs='+', default=['720x540', '1440x1080', '2448x2048'],
+                        help='sensor sizes to run, WIDTHxHEIGHT')
+    parser.add_argument('--fps', type=float, default=30.0, help='frame rate of the master camera')
+    parser.add_argument('--duration', type=float, default=20.0, help='secs recorded per run')
+    parser.add_argument('--warmup', type=float, default=5.0, help='secs before recording starts')
+    parser.add_argument('--color', action='store_true', help='BayerRG8 cameras, converted to BGR8')
+    parser.add_argument('--save-type', default='bmp', help='save_type of the driver')
+    parser.add_argument('--soft-trigger', action='store_true', help='run the soft trigger loop instead of max_rate_save')
+    parser.add_argument('--output', default='throughput_results.json', help='results file')
+    parser.add_argument('--baselines', default=default_baselines, help='baselines file')
+    parser.add_argument('--update-baselines', action='store_true', help='store the results as the new baselines')
+    parser.add_argument('--fps-tolerance', type=float, default=0.05, help='allowed fraction of fps below the baseline')
+    parser.add_argument('--latency-tolerance', type=float, default=0.5,
+                        help='allowed fraction of stage p99 latency above the baseline')
+    parser.add_argument('--drop-allowance', type=int, default=0, help='lost frames allowed above the baseline')
+    parser.add_argument('--keep-images', action='store_true', help='keep the saved images of each run')
+    args = parser.parse_args(rospy.myargv()[1:])
+
+    core = ensure_master()
+    rospy.init_node('throughput_harness', anonymous=True, disable_signals=True)
+
+    baselines = {}
+    if os.path.exists(args.baselines):
+        with open(args.baselines) as f:
+            baselines = dict((run['name'], run) for run in json.load(f)['runs'])
+
+    results = []
+    regressions = []
+    try:
+        for num_cams in args.cameras:
+            for resolution in args.resolutions:
+                result = run(num_cams, resolution, args)
+                results.append(result)
+                if result['name'] in baselines:
+                    regressions += compare(result, baselines[result['name']], args)
+                else:
+                    print('%s: no baseline' % result['name'])
+    finally:
+        rospy.signal_shutdown('done')
+        if core:
+            core.send_signal(signal.SIGINT)
+            core.wait()
+
+    report = {
+        'host': platform.node(),
+        'date': datetime.datetime.now().isoformat(),
+        'settings': {'fps': args.fps, 'duration': args.duration, 'warmup': args.warmup, 'color': args.color,
+                     'save_type': args.save_type, 'soft_trigger': args.soft_trigger},
+        'runs': results,
+        'regressions': regressions,
+    }
+    with open(args.output, 'w') as f:
+        json.dump(report, f, indent=2, sort_keys=True)
+    print('Results written to %s' % args.output)
+
+    if args.update_baselines:
+        report['regressions'] = []
+        with open(args.baselines, 'w') as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+        print('Baselines written to %s' % args.baselines)
+        return 0
+
+    for regression in regressions:
+        print('REGRESSION ' + regression)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
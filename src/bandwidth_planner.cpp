@@ -0,0 +1,124 @@
+#include "spinnaker_sdk_camera_driver/bandwidth_planner.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+void acquisition::BandwidthPlanner::add(int cam, const string& controller, double required_bps) {
+
+    Link link;
+    link.controller = controller;
+    link.required_bps = required_bps;
+    link.limit_bps = 0;
+    link.feasible = true;
+    links_[cam] = link;
+
+}
+
+void acquisition::BandwidthPlanner::plan() {
+
+    loads_.clear();
+    for (map<int, Link>::iterator it = links_.begin(); it != links_.end(); ++it)
+        if (!it->second.controller.empty())
+            loads_[it->second.controller] += it->second.required_bps;
+
+    for (map<int, Link>::iterator it = links_.begin(); it != links_.end(); ++it) {
+        Link& link = it->second;
+        if (link.controller.empty() || controller_bps_ <= 0) {
+            link.limit_bps = 0;
+            link.feasible = true;
+            continue;
+        }
+        double load = loads_[link.controller];
+        link.feasible = load <= controller_bps_;
+        link.limit_bps = load > 0 ? (int64_t)(controller_bps_ * link.required_bps / load) : (int64_t)controller_bps_;
+    }
+
+}
+
+const acquisition::BandwidthPlanner::Link* acquisition::BandwidthPlanner::link(int cam) const {
+
+    map<int, Link>::const_iterator it = links_.find(cam);
+    return it == links_.end() ? NULL : &it->second;
+
+}
+
+int64_t acquisition::BandwidthPlanner::limit(int cam) const {
+
+    const Link* l = link(cam);
+    return l ? l->limit_bps : 0;
+
+}
+
+bool acquisition::BandwidthPlanner::feasible(int cam) const {
+
+    const Link* l = link(cam);
+    return l ? l->feasible : true;
+
+}
+
+double acquisition::BandwidthPlanner::required(int cam) const {
+
+    const Link* l = link(cam);
+    return l ? l->required_bps : 0;
+
+}
+
+static string read_line(const boost::filesystem::path& file) {
+
+    std::ifstream in(file.string().c_str());
+    string line;
+    getline(in, line);
+    return line;
+
+}
+
+static string strip_zeros(string s) {
+
+    transform(s.begin(), s.end(), s.begin(), ::toupper);
+    size_t first = s.find_first_not_of('0');
+    return first == string::npos ? "" : s.substr(first);
+
+}
+
+string acquisition::BandwidthPlanner::usb_controller(const string& serial) {
+
+    namespace fs = boost::filesystem;
+
+    // FLIR cameras report their serial number in hex as USB serial, some firmware in decimal
+    char hex[32];
+    snprintf(hex, sizeof(hex), "%llX", strtoull(serial.c_str(), NULL, 10));
+    string wanted_dec = strip_zeros(serial);
+    string wanted_hex = strip_zeros(hex);
+
+    fs::path devices("/sys/bus/usb/devices");
+    boost::system::error_code ec;
+    if (!fs::is_directory(devices, ec))
+        return "";
+
+    for (fs::directory_iterator it(devices, ec), end; !ec && it != end; it.increment(ec)) {
+        fs::path serial_file = it->path() / "serial";
+        if (!fs::exists(serial_file, ec))
+            continue;
+        string usb_serial = strip_zeros(read_line(serial_file));
+        if (usb_serial.empty() || (usb_serial != wanted_dec && usb_serial != wanted_hex))
+            continue;
+
+        // e.g. /sys/devices/pci0000:00/0000:00:14.0/usb2/2-1/2-1.4, the controller is the parent of the root hub usbN
+        fs::path device = fs::canonical(it->path(), ec);
+        if (ec)
+            return "";
+        fs::path controller;
+        for (fs::path::iterator part = device.begin(); part != device.end(); ++part) {
+            string name = part->string();
+            if (name.size() > 3 && name.compare(0, 3, "usb") == 0 && isdigit(name[3]))
+                return controller.string();
+            controller /= *part;
+        }
+        return "";
+    }
+    return "";
+
+}
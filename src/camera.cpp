@@ -10,8 +10,16 @@ acquisition::Camera::~Camera() {
 acquisition::Camera::Camera(CameraPtr pCam) {
 
     pCam_ = pCam;
+    nodes_.reset(new NodeCache());
+    counters_.reset(new FrameCounters());
 
-    if (pCam_->IsInitialized()) {
+    // the TL device nodemap is readable without Init(), serial and model never change
+    serial_ = getTLNodeStringValue("DeviceSerialNumber");
+    model_ = getTLNodeStringValue("DeviceModelName");
+
+    // the cleanup below hides what a previous run left behind, is_clean() still reports it
+    LEFT_INITIALIZED_ = pCam_->IsInitialized();
+    if (LEFT_INITIALIZED_) {
         ROS_WARN_STREAM("Camera already initialized. Deinitializing...");
         pCam_->EndAcquisition();
         pCam_->DeInit();
@@ -20,44 +28,115 @@ acquisition::Camera::Camera(CameraPtr pCam) {
     lastFrameID_ = -1;
     frameID_ = -1;
     MASTER_ = false;
+    CHUNK_DATA_ = false;
+    chunk_.valid = false;
+    timestamp_ = 0;
+    GET_NEXT_IMAGE_TIMEOUT_ = EVENT_TIMEOUT_INFINITE;
+}
+
+acquisition::Camera::Camera(std::shared_ptr<FrameSource> source) {
+
+    source_ = source;
+    nodes_.reset(new NodeCache());
+    counters_.reset(new FrameCounters());
+    serial_ = source_->id();
+    model_ = source_->model();
+    LEFT_INITIALIZED_ = false;
+
+    lastFrameID_ = -1;
+    frameID_ = -1;
+    MASTER_ = false;
+    CHUNK_DATA_ = false;
+    chunk_.valid = false;
     timestamp_ = 0;
     GET_NEXT_IMAGE_TIMEOUT_ = EVENT_TIMEOUT_INFINITE;
 }
 
 void acquisition::Camera::init() {
 
-    pCam_->Init();
+    if (source_) {
+        source_->init();
+        return;
+    }
+    // a camera that skipped the flush is still initialized from the readiness check
+    if (!pCam_->IsInitialized())
+        pCam_->Init();
+    resolve_nodes();
     
 }
 
 void acquisition::Camera::deinit() {
 
+    if (source_) {
+        source_->deinit();
+        return;
+    }
+    // node handles die with the nodemap
+    {
+        boost::mutex::scoped_lock lock(nodes_->mutex);
+        nodes_->enums.clear();
+        nodes_->ints.clear();
+        nodes_->floats.clear();
+        nodes_->bools.clear();
+        nodes_->trigger_software = CCommandPtr();
+        nodes_->timestamp_latch = CCommandPtr();
+        nodes_->timestamp_latch_value = CIntegerPtr();
+    }
     pCam_->DeInit();
 
 }
 
+// Looks up all nodes the driver sets once, so configuration and triggering skip the string lookups
+void acquisition::Camera::resolve_nodes() {
+
+    INodeMap & nodeMap = pCam_->GetNodeMap();
+
+    const char* enums[] = {"ExposureMode", "ExposureAuto", "GainAuto", "AutoExposureTargetGreyValueAuto",
+                           "PixelFormat", "AcquisitionMode", "LineSelector", "LineMode", "LineSource",
+                           "TriggerMode", "TriggerSource", "TriggerSelector", "TriggerOverlap", "TriggerActivation"};
+    const char* ints[] = {"BinningHorizontal", "BinningVertical", "Width", "Height", "OffsetX", "OffsetY"};
+    const char* floats[] = {"ExposureTime", "Gain", "AutoExposureTargetGreyValue", "AcquisitionFrameRate", "TriggerDelay"};
+    const char* bools[] = {"ReverseX", "ReverseY", "AcquisitionFrameRateEnable", "ChunkModeActive"};
+
+    boost::mutex::scoped_lock lock(nodes_->mutex);
+    for (int i = 0; i < sizeof(enums)/sizeof(enums[0]); i++)
+        nodes_->enums[enums[i]] = nodeMap.GetNode(enums[i]);
+    for (int i = 0; i < sizeof(ints)/sizeof(ints[0]); i++)
+        nodes_->ints[ints[i]] = nodeMap.GetNode(ints[i]);
+    for (int i = 0; i < sizeof(floats)/sizeof(floats[0]); i++)
+        nodes_->floats[floats[i]] = nodeMap.GetNode(floats[i]);
+    for (int i = 0; i < sizeof(bools)/sizeof(bools[0]); i++)
+        nodes_->bools[bools[i]] = nodeMap.GetNode(bools[i]);
+    nodes_->trigger_software = nodeMap.GetNode("TriggerSoftware");
+    nodes_->timestamp_latch = nodeMap.GetNode("TimestampLatch");
+    nodes_->timestamp_latch_value = nodeMap.GetNode("TimestampLatchValue");
+
+}
+
 ImagePtr acquisition::Camera::grab_frame() {
+    if (source_)
+        return grab_source_frame();
     ImagePtr pResultImage;
     try{
-        pResultImage = pCam_->GetNextImage(GET_NEXT_IMAGE_TIMEOUT_);
+        pResultImage = next_image();
+        // called off while waiting for a trigger
+        if (!pResultImage.IsValid())
+            return pResultImage;
         // Check if the Image is complete
 
         if (pResultImage->IsIncomplete()) {
 
+            counters_->incomplete++;
             ROS_WARN_STREAM("Image incomplete with image status " << pResultImage->GetImageStatus() << "!");
 
         } else {
 
             timestamp_ = pResultImage->GetTimeStamp();
+            if (CHUNK_DATA_)
+                read_chunk_data(pResultImage, chunk_);
 
-            if (frameID_ >= 0) {
-                lastFrameID_ = frameID_;
-                frameID_ = pResultImage->GetFrameID();
-                ROS_WARN_STREAM_COND(frameID_ > lastFrameID_ + 1,"Frames are being skipped!");
-            } else {
-                frameID_ = pResultImage->GetFrameID();
-                // ROS_ASSERT_MSG(frameID_ == 0 ,"First frame ID was not zero! Might cause sync issues later...");
-            }
+            count_frame(pResultImage->GetFrameID());
+            counters_->frames++;
 
         }
 
@@ -65,12 +144,80 @@ ImagePtr acquisition::Camera::grab_frame() {
         return pResultImage;
     }
     catch(Spinnaker::Exception &e){
+       counters_->timeouts++;
        ROS_FATAL_STREAM(e.what()<<"\n Likely reason is that slaves are not triggered. Check GPIO cables\n");
     }
 
     return pResultImage;
 }
 
+// Waiting for an external or code trigger has no timeout, it is cut into slices so grab_abort_ can call it off
+ImagePtr acquisition::Camera::next_image() {
+
+    if (GET_NEXT_IMAGE_TIMEOUT_ != EVENT_TIMEOUT_INFINITE || !grab_abort_)
+        return pCam_->GetNextImage(GET_NEXT_IMAGE_TIMEOUT_);
+    while (true) {
+        try {
+            return pCam_->GetNextImage(GRAB_SLICE_MS);
+        }
+        catch (Spinnaker::Exception &e) {
+            if (e.GetError() != SPINNAKER_ERR_TIMEOUT)
+                throw;
+        }
+        if (grab_abort_())
+            return ImagePtr();
+    }
+
+}
+
+// Wraps the next image of the source into a Spinnaker image, so it takes the same conversion and save paths
+ImagePtr acquisition::Camera::grab_source_frame() {
+
+    SourceFrame frame;
+    bool sliced = GET_NEXT_IMAGE_TIMEOUT_ == EVENT_TIMEOUT_INFINITE && grab_abort_;
+    while (sliced && !source_->next_frame(frame, GRAB_SLICE_MS))
+        if (grab_abort_() || !source_->is_streaming())
+            return ImagePtr();
+    if (!sliced && !source_->next_frame(frame, GET_NEXT_IMAGE_TIMEOUT_)) {
+        counters_->timeouts++;
+        ROS_ERROR_STREAM("Camera " << get_id() << ": no image from the simulated camera within the timeout");
+        return ImagePtr();
+    }
+    timestamp_ = frame.timestamp_ns;
+    count_frame((int)frame.frame_id);
+    counters_->frames++;
+    if (CHUNK_DATA_) {
+        chunk_.exposure_time_us = frame.exposure_time_us;
+        chunk_.gain_db = frame.gain_db;
+        chunk_.device_timestamp_ns = frame.timestamp_ns;
+        chunk_.frame_id = frame.frame_id;
+        chunk_.line_status = 0;
+        chunk_.valid = true;
+    }
+
+    ImagePtr image = Image::Create();
+    image->DeepCopy(Image::Create(frame.image.cols, frame.image.rows, 0, 0, frame.format, frame.image.data));
+    ROS_DEBUG_STREAM("Grabbed frame from simulated camera " << get_id() << " with timestamp " << timestamp_);
+    return image;
+
+}
+
+void acquisition::Camera::count_frame(int frame_id) {
+
+    if (frameID_ >= 0) {
+        lastFrameID_ = frameID_;
+        frameID_ = frame_id;
+        if (frameID_ > lastFrameID_ + 1) {
+            counters_->skipped_ids += frameID_ - lastFrameID_ - 1;
+            ROS_WARN_STREAM("Frames are being skipped!");
+        }
+    } else {
+        frameID_ = frame_id;
+        // ROS_ASSERT_MSG(frameID_ == 0 ,"First frame ID was not zero! Might cause sync issues later...");
+    }
+
+}
+
 // Returns last timestamp
 string acquisition::Camera::get_time_stamp() {
 
@@ -86,17 +233,46 @@ int acquisition::Camera::get_frame_id() {
 
 }
 
-Mat acquisition::Camera::grab_mat_frame() {
+// Latches the device clock and reads it back, bracketed by host (ROS) time
+bool acquisition::Camera::latch_timestamp(int64_t& device_ns, int64_t& host_before_ns, int64_t& host_after_ns) {
+
+    if (source_) {
+        host_before_ns = ros::Time::now().toNSec();
+        device_ns = source_->device_time_ns();
+        host_after_ns = ros::Time::now().toNSec();
+        return true;
+    }
+    // deinit() clears the cached nodes from another thread
+    boost::mutex::scoped_lock lock(nodes_->mutex);
+    CCommandPtr latchPtr = nodes_->timestamp_latch;
+    CIntegerPtr valuePtr = nodes_->timestamp_latch_value;
+    if (!IsAvailable(latchPtr) || !IsWritable(latchPtr) || !IsAvailable(valuePtr) || !IsReadable(valuePtr))
+        return false;
+
+    host_before_ns = ros::Time::now().toNSec();
+    latchPtr->Execute();
+    host_after_ns = ros::Time::now().toNSec();
+    device_ns = valuePtr->GetValue();
+    return true;
+
+}
+
+bool acquisition::Camera::grab_mat_frame(Mat& frame, bool convert) {
 
     try{
         ImagePtr pResultImage = grab_frame();
-        return convert_to_mat(pResultImage);
+        // a camera that timed out or was unplugged delivers no image
+        if (!pResultImage.IsValid())
+            return false;
+        // frames no output wants are still grabbed to keep the cameras in step, but not converted
+        frame = convert ? convert_to_mat(pResultImage) : Mat();
+        return true;
     }
     catch(Spinnaker::Exception &e){
-        ros::shutdown();
+        ROS_ERROR_STREAM("Camera " << get_id() << ": " << e.what());
+        return false;
     }
 
-
 }
 
 Mat acquisition::Camera::convert_to_mat(ImagePtr pImage) {
@@ -121,15 +297,98 @@ Mat acquisition::Camera::convert_to_mat(ImagePtr pImage) {
     
 }
 
+// Stops and deinitializes a camera that was unplugged, as far as it still responds
+void acquisition::Camera::release_device() {
+
+    if (source_) {
+        source_->end_acquisition();
+        source_->deinit();
+        return;
+    }
+    try {
+        if (pCam_->IsStreaming())
+            pCam_->EndAcquisition();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_DEBUG_STREAM("Camera " << get_id() << ": EndAcquisition failed: " << e.what());
+    }
+    try {
+        deinit();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_DEBUG_STREAM("Camera " << get_id() << ": DeInit failed: " << e.what());
+    }
+
+}
+
+// Takes over the device of a camera that was plugged back in, frame counting starts over
+void acquisition::Camera::attach_device(CameraPtr pCam) {
+
+    pCam_ = pCam;
+    lastFrameID_ = -1;
+    frameID_ = -1;
+    timestamp_ = 0;
+    chunk_.valid = false;
+
+}
+
 void acquisition::Camera::begin_acquisition() {
 
     ROS_DEBUG_STREAM("Begin Acquisition...");
-    pCam_->BeginAcquisition();
+    if (source_)
+        source_->begin_acquisition();
+    else
+        pCam_->BeginAcquisition();
     
 }
 
+// True if the camera is neither streaming nor locked in an acquisition left over by a previous run
+bool acquisition::Camera::is_clean() {
+
+    if (LEFT_INITIALIZED_)
+        return false;
+    if (source_)
+        return !source_->is_streaming();
+    if (pCam_->IsStreaming())
+        return false;
+
+    // the device locks its transport layer parameters while it acquires
+    CIntegerPtr lockedPtr = pCam_->GetNodeMap().GetNode("TLParamsLocked");
+    if (IsAvailable(lockedPtr) && IsReadable(lockedPtr) && lockedPtr->GetValue() != 0)
+        return false;
+
+    return pCam_->GetNumImagesInUse() == 0;
+
+}
+
+// Releases images still waiting in the stream buffers, returns how many there were
+int acquisition::Camera::drain_buffers() {
+
+    if (source_)
+        return 0;
+    int drained = 0;
+    while (drained < 1000) {
+        try {
+            ImagePtr pImage = pCam_->GetNextImage(10);
+            pImage->Release();
+            drained++;
+        }
+        catch (Spinnaker::Exception &e) {
+            // times out once the buffers are empty
+            break;
+        }
+    }
+    return drained;
+
+}
+
 void acquisition::Camera::end_acquisition() {
 
+    if (source_) {
+        ROS_DEBUG_STREAM("End Acquisition...");
+        source_->end_acquisition();
+        return;
+    }
     if (pCam_->GetNumImagesInUse())
         ROS_WARN_STREAM("Some images still currently in use! Use image->Release() before deinitializing.");
         
@@ -138,12 +397,109 @@ void acquisition::Camera::end_acquisition() {
     
 }
 
-void acquisition::Camera::setEnumValue(string setting, string value) {
+bool acquisition::Camera::enableChunkData() {
 
+    // simulated cameras fill the chunk values from their own settings
+    if (source_) {
+        CHUNK_DATA_ = true;
+        return true;
+    }
     INodeMap & nodeMap = pCam_->GetNodeMap();
-    
+
+    CBooleanPtr ptrChunkModeActive = nodeMap.GetNode("ChunkModeActive");
+    if (!IsAvailable(ptrChunkModeActive) || !IsWritable(ptrChunkModeActive)) {
+        ROS_WARN_STREAM("Camera " << get_id() << " does not support chunk data");
+        return false;
+    }
+    ptrChunkModeActive->SetValue(true);
+
+    // chunks a camera model doesn't have are left out, their values read as 0
+    CEnumerationPtr ptrChunkSelector = nodeMap.GetNode("ChunkSelector");
+    if (!IsAvailable(ptrChunkSelector) || !IsWritable(ptrChunkSelector)) {
+        ROS_WARN_STREAM("Camera " << get_id() << " can't select chunks, using its default chunks");
+        CHUNK_DATA_ = true;
+        return true;
+    }
+    const char* chunks[] = {"ExposureTime", "Gain", "Timestamp", "FrameID", "ExposureEndLineStatusAll"};
+    for (int i = 0; i < sizeof(chunks)/sizeof(chunks[0]); i++) {
+        CEnumEntryPtr ptrEntry = ptrChunkSelector->GetEntryByName(chunks[i]);
+        if (!IsAvailable(ptrEntry) || !IsReadable(ptrEntry)) {
+            ROS_WARN_STREAM("Camera " << get_id() << " has no " << chunks[i] << " chunk");
+            continue;
+        }
+        ptrChunkSelector->SetIntValue(ptrEntry->GetValue());
+
+        CBooleanPtr ptrChunkEnable = nodeMap.GetNode("ChunkEnable");
+        if (IsAvailable(ptrChunkEnable) && IsWritable(ptrChunkEnable))
+            ptrChunkEnable->SetValue(true);
+        ROS_DEBUG_STREAM("Chunk " << chunks[i] << " enabled");
+    }
+
+    CHUNK_DATA_ = true;
+    return true;
+
+}
+
+// Selects user_set and runs UserSetLoad or UserSetSave on it, false if the camera can't
+bool acquisition::Camera::execute_user_set_command(const string& user_set, const char* command) {
+
+    if (source_)
+        return false;
+    try {
+        CEnumerationPtr ptrSelector = cached_node(nodes_->enums, "UserSetSelector");
+        if (!IsAvailable(ptrSelector) || !IsWritable(ptrSelector))
+            return false;
+        CEnumEntryPtr ptrEntry = ptrSelector->GetEntryByName(user_set.c_str());
+        if (!IsAvailable(ptrEntry) || !IsReadable(ptrEntry)) {
+            ROS_WARN_STREAM("Camera " << get_id() << " has no user set " << user_set);
+            return false;
+        }
+        ptrSelector->SetIntValue(ptrEntry->GetValue());
+
+        CCommandPtr ptrCommand = pCam_->GetNodeMap().GetNode(command);
+        if (!IsAvailable(ptrCommand) || !IsWritable(ptrCommand))
+            return false;
+        ptrCommand->Execute();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_WARN_STREAM("Camera " << get_id() << ": " << command << " " << user_set << " failed: " << e.what());
+        return false;
+    }
+
+    ROS_DEBUG_STREAM("Camera " << get_id() << ": " << command << " " << user_set);
+    return true;
+
+}
+
+bool acquisition::Camera::read_chunk_data(ImagePtr pImage, ChunkMetadata& chunk) {
+
+    // chunk data comes in the image buffer, reading it doesn't touch the device
+    try {
+        const ChunkData& chunkData = pImage->GetChunkData();
+        chunk.exposure_time_us = chunkData.GetExposureTime();
+        chunk.gain_db = chunkData.GetGain();
+        chunk.device_timestamp_ns = chunkData.GetTimestamp();
+        chunk.frame_id = chunkData.GetFrameID();
+        chunk.line_status = chunkData.GetExposureEndLineStatusAll();
+        chunk.valid = true;
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_DEBUG_STREAM("No chunk data in image: " << e.what());
+        chunk.valid = false;
+    }
+    return chunk.valid;
+
+}
+
+void acquisition::Camera::setEnumValue(string setting, string value) {
+
+    if (source_) {
+        source_->set_enum(setting, value);
+        ROS_DEBUG_STREAM(setting << " set to " << value);
+        return;
+    }
     // Retrieve enumeration node from nodemap
-    CEnumerationPtr ptr = nodeMap.GetNode(setting.c_str());
+    CEnumerationPtr ptr = cached_node(nodes_->enums, setting);
     if (!IsAvailable(ptr) || !IsWritable(ptr))
         ROS_FATAL_STREAM("Unable to set " << setting << " to " << value << " (enum retrieval). Aborting...");
 
@@ -164,9 +520,12 @@ void acquisition::Camera::setEnumValue(string setting, string value) {
 
 void acquisition::Camera::setIntValue(string setting, int val) {
 
-    INodeMap & nodeMap = pCam_->GetNodeMap();
-    
-    CIntegerPtr ptr = nodeMap.GetNode(setting.c_str());
+    if (source_) {
+        source_->set_int(setting, val);
+        ROS_DEBUG_STREAM(setting << " set to " << val);
+        return;
+    }
+    CIntegerPtr ptr = cached_node(nodes_->ints, setting);
     if (!IsAvailable(ptr) || !IsWritable(ptr)) {
         ROS_FATAL_STREAM("Unable to set " << setting << " to " << val << " (ptr retrieval). Aborting...");
     }
@@ -178,9 +537,12 @@ void acquisition::Camera::setIntValue(string setting, int val) {
 
 void acquisition::Camera::setFloatValue(string setting, float val) {
 
-    INodeMap & nodeMap = pCam_->GetNodeMap();
-    
-    CFloatPtr ptr = nodeMap.GetNode(setting.c_str());
+    if (source_) {
+        source_->set_float(setting, val);
+        ROS_DEBUG_STREAM(setting << " set to " << val);
+        return;
+    }
+    CFloatPtr ptr = cached_node(nodes_->floats, setting);
     if (!IsAvailable(ptr) || !IsWritable(ptr)) {
         ROS_FATAL_STREAM("Unable to set " << setting << " to " << val << " (ptr retrieval). Aborting...");
     }
@@ -192,9 +554,12 @@ void acquisition::Camera::setFloatValue(string setting, float val) {
 
 void acquisition::Camera::setBoolValue(string setting, bool val) {
 
-    INodeMap & nodeMap = pCam_->GetNodeMap();
-    
-    CBooleanPtr ptr = nodeMap.GetNode(setting.c_str());
+    if (source_) {
+        source_->set_bool(setting, val);
+        ROS_DEBUG_STREAM(setting << " set to " << val);
+        return;
+    }
+    CBooleanPtr ptr = cached_node(nodes_->bools, setting);
     if (!IsAvailable(ptr) || !IsWritable(ptr)) {
         ROS_FATAL_STREAM("Unable to set " << setting << " to " << val << " (ptr retrieval). Aborting...");
     }
@@ -245,16 +610,90 @@ void acquisition::Camera::adcBitDepth(gcstring bitDep) {
 
 }
 
-void acquisition::Camera::setBufferSize(int numBuf) {
+int acquisition::Camera::setBufferSize(int numBuf) {
+
+    // a simulated camera hands its images over directly
+    if (source_)
+        return numBuf;
     INodeMap & sNodeMap = pCam_->GetTLStreamNodeMap();
+
+    // the count is only used while the count mode is manual
+    CEnumerationPtr ptrMode = sNodeMap.GetNode("StreamBufferCountMode");
+    if (IsAvailable(ptrMode) && IsWritable(ptrMode)) {
+        CEnumEntryPtr ptrManual = ptrMode->GetEntryByName("Manual");
+        if (IsAvailable(ptrManual) && IsReadable(ptrManual))
+            ptrMode->SetIntValue(ptrManual->GetValue());
+    }
+
     CIntegerPtr StreamNode = sNodeMap.GetNode("StreamBufferCountManual");
-    int64_t bufferCount = StreamNode->GetValue();
     if (!IsAvailable(StreamNode) || !IsWritable(StreamNode)){
-        ROS_FATAL_STREAM("Unable to set StreamMode " << "). Aborting...");
-        return;
+        ROS_ERROR_STREAM("Unable to set StreamBufferCountManual on camera " << get_id());
+        return -1;
     }
-    StreamNode->SetValue(numBuf);
-    ROS_DEBUG_STREAM("Set Buf "<<numBuf<<endl);
+    int64_t count = numBuf;
+    count = max(count, (int64_t)StreamNode->GetMin());
+    count = min(count, (int64_t)StreamNode->GetMax());
+    StreamNode->SetValue(count);
+    ROS_DEBUG_STREAM("Set Buf " << count);
+    return (int)count;
+}
+
+bool acquisition::Camera::setBufferHandlingMode(const string& mode) {
+
+    if (source_)
+        return true;
+    CEnumerationPtr ptr = pCam_->GetTLStreamNodeMap().GetNode("StreamBufferHandlingMode");
+    if (!IsAvailable(ptr) || !IsWritable(ptr)) {
+        ROS_ERROR_STREAM("Unable to set StreamBufferHandlingMode on camera " << get_id());
+        return false;
+    }
+    CEnumEntryPtr ptrValue = ptr->GetEntryByName(mode.c_str());
+    if (!IsAvailable(ptrValue) || !IsReadable(ptrValue)) {
+        ROS_ERROR_STREAM("Camera " << get_id() << " has no StreamBufferHandlingMode " << mode);
+        return false;
+    }
+    ptr->SetIntValue(ptrValue->GetValue());
+    ROS_DEBUG_STREAM("StreamBufferHandlingMode set to " << mode);
+    return true;
+}
+
+// limits the camera's USB bandwidth in bytes/s, returns the limit that was set or 0 if the camera can't be limited
+int64_t acquisition::Camera::setThroughputLimit(int64_t bps) {
+
+    if (source_)
+        return 0;
+    INodeMap& nodeMap = pCam_->GetNodeMap();
+    CEnumerationPtr ptrMode = nodeMap.GetNode("DeviceLinkThroughputLimitMode");
+    if (IsAvailable(ptrMode) && IsWritable(ptrMode)) {
+        CEnumEntryPtr ptrOn = ptrMode->GetEntryByName("On");
+        if (IsAvailable(ptrOn) && IsReadable(ptrOn))
+            ptrMode->SetIntValue(ptrOn->GetValue());
+    }
+
+    CIntegerPtr ptr = cached_node(nodes_->ints, "DeviceLinkThroughputLimit");
+    if (!IsAvailable(ptr) || !IsWritable(ptr)) {
+        ROS_WARN_STREAM("Unable to set DeviceLinkThroughputLimit on camera " << get_id());
+        return 0;
+    }
+    int64_t limit = min(max(bps, (int64_t)ptr->GetMin()), (int64_t)ptr->GetMax());
+    // the value has to be a multiple of the increment
+    int64_t inc = ptr->GetInc();
+    if (inc > 1)
+        limit = ptr->GetMin() + (limit - ptr->GetMin()) / inc * inc;
+    ptr->SetValue(limit);
+    ROS_DEBUG_STREAM("DeviceLinkThroughputLimit set to " << limit);
+    return limit;
+}
+
+// bytes per image as configured, 0 if the camera doesn't tell
+int64_t acquisition::Camera::getPayloadSize() {
+
+    if (source_)
+        return source_->payload_size();
+    CIntegerPtr ptr = cached_node(nodes_->ints, "PayloadSize");
+    if (!IsAvailable(ptr) || !IsReadable(ptr))
+        return 0;
+    return ptr->GetValue();
 }
 
 void acquisition::Camera::setISPEnable() {
@@ -295,16 +734,23 @@ void acquisition::Camera::setPixelFormat(gcstring formatPic) {
 
 void acquisition::Camera::trigger() {
 
-    INodeMap & nodeMap = pCam_->GetNodeMap();
-    
-    CCommandPtr ptr = nodeMap.GetNode("TriggerSoftware");
-    if (!IsAvailable(ptr) || !IsWritable(ptr))
+    if (source_) {
+        source_->trigger();
+        return;
+    }
+    boost::mutex::scoped_lock lock(nodes_->mutex);
+    CCommandPtr ptr = nodes_->trigger_software;
+    if (!IsAvailable(ptr) || !IsWritable(ptr)) {
         ROS_FATAL_STREAM("Unable to execute trigger. Aborting...");
+        return;
+    }
     ptr->Execute();
     
 }
 
 double acquisition::Camera::getFloatValueMax(string node_string) {
+    if (source_)
+        return source_->get_float_max(node_string);
     INodeMap& nodeMap = pCam_->GetNodeMap();
 
     CFloatPtr ptrNodeValue = nodeMap.GetNode(node_string.c_str());
@@ -319,7 +765,24 @@ double acquisition::Camera::getFloatValueMax(string node_string) {
 }
 
 
+int acquisition::Camera::getIntValueMax(string node_string) {
+
+    if (source_)
+        return (int)source_->get_int_max(node_string);
+    CIntegerPtr ptr = cached_node(nodes_->ints, node_string);
+    if (!IsAvailable(ptr) || !IsReadable(ptr)) {
+        ROS_FATAL_STREAM("Node " << node_string << " not available" << endl);
+        return -1;
+    }
+    return (int)ptr->GetMax();
+}
+
 string acquisition::Camera::getTLNodeStringValue(string node_string) {
+    if (source_) {
+        if (node_string == "DeviceSerialNumber")
+            return source_->id();
+        return node_string == "DeviceModelName" ? source_->model() : "";
+    }
     INodeMap& nodeMap = pCam_->GetTLDeviceNodeMap();
     CStringPtr ptrNodeValue = nodeMap.GetNode(node_string.c_str());
     if (IsReadable(ptrNodeValue)){
@@ -330,8 +793,22 @@ string acquisition::Camera::getTLNodeStringValue(string node_string) {
     }
 }
 
-string acquisition::Camera::get_id() {
-    return getTLNodeStringValue("DeviceSerialNumber");
+void acquisition::Camera::read_stream_counters(StreamCounters& counters) {
+
+    const char* names[] = {"StreamLostFrameCount", "StreamFailedBufferCount", "StreamDroppedFrameCount",
+                           "StreamBufferUnderrunCount", "StreamPacketResendRequestCount"};
+    int64_t* values[] = {&counters.lost_frames, &counters.failed_buffers, &counters.dropped_frames,
+                         &counters.buffer_underruns, &counters.resend_requests};
+
+    for (int k = 0; k < sizeof(names)/sizeof(names[0]); k++) {
+        if (source_) {
+            *values[k] = source_->stream_counter(names[k]);
+            continue;
+        }
+        CIntegerPtr ptrNodeValue = pCam_->GetTLStreamNodeMap().GetNode(names[k]);
+        *values[k] = IsAvailable(ptrNodeValue) && IsReadable(ptrNodeValue) ? ptrNodeValue->GetValue() : -1;
+    }
+
 }
 
 void acquisition::Camera::targetGreyValueTest() {
@@ -357,6 +834,8 @@ void acquisition::Camera::exposureTest() {
 
 }
 bool acquisition::Camera::verifyBinning(int binningDesired) {
+    if (source_)
+        return true;
     int actualBinningX =  (pCam_ ->SensorWidth())/(pCam_ ->Width());
     int actualBinningY =  (pCam_ ->SensorHeight())/(pCam_ ->Height());
     if (binningDesired == actualBinningX) return true;
@@ -364,6 +843,8 @@ bool acquisition::Camera::verifyBinning(int binningDesired) {
 }
 
 void acquisition::Camera::calibrationParamsTest(int calibrationWidth, int calibrationHeight) {
+    if (source_)
+        return;
     if ( (pCam_ ->SensorWidth()) != calibrationWidth )
         ROS_WARN_STREAM(" Looks like your calibration is not done at full Sensor Resolution for cam_id = "<<get_id()<<" , Sensor_Width = "<<(pCam_ ->SensorWidth()) <<" given cameraInfo params:width = "<<calibrationWidth);
     if ( (pCam_ ->SensorHeight()) != calibrationHeight )
@@ -8,6 +8,29 @@ acquisition::Capture::~Capture(){
 
     // destructor
     ROS_DEBUG("Capture destructor started");
+    if (tracing_enabled()) {
+        disable_tracing();
+        if (write_trace(trace_file_))
+            ROS_INFO_STREAM("Trace written to " << trace_file_);
+        else
+            ROS_ERROR_STREAM("Could not write the trace to " << trace_file_);
+    }
+    // the helper threads use the cameras, they have to be gone before the cameras are
+    if (clockSyncThread_) {
+        clockSyncThread_->interrupt();
+        clockSyncThread_->join();
+    }
+    clockSyncThread_.reset();
+    if (hotplugThread_) {
+        hotplugThread_->interrupt();
+        hotplugThread_->join();
+    }
+    hotplugThread_.reset();
+    if (streamStatsThread_) {
+        streamStatsThread_->interrupt();
+        streamStatsThread_->join();
+    }
+    streamStatsThread_.reset();
     ifstream file(dump_img_.c_str());
     if (file)
         if (remove(dump_img_.c_str()) != 0)
@@ -24,6 +47,8 @@ acquisition::Capture::~Capture(){
     ROS_INFO_STREAM("Releasing camera pointers...");
     cams.clear();
 
+    compressed_pub_.shutdown();
+
     ROS_INFO_STREAM("Releasing system instance...");
     system_->ReleaseInstance();
 
@@ -53,6 +78,12 @@ void acquisition::Capture::onInit() {
     // set values to global class variables and register pub, sub to ros
     init_variables_register_to_ros();
     init_array();
+    if (clock_sync_interval_ > 0)
+        clockSyncThread_.reset(new boost::thread(boost::bind(&acquisition::Capture::sync_clocks, this)));
+    if (hotplug_interval_ > 0)
+        hotplugThread_.reset(new boost::thread(boost::bind(&acquisition::Capture::watch_cameras, this)));
+    if (stream_stats_interval_ > 0)
+        streamStatsThread_.reset(new boost::thread(boost::bind(&acquisition::Capture::poll_stream_stats, this)));
     // calling capture::run() in a different thread
     pubThread_.reset(new boost::thread(boost::bind(&acquisition::Capture::run, this)));
     NODELET_INFO("onInit Initialized");
@@ -78,9 +109,7 @@ void acquisition::Capture::init_variables_register_to_ros() {
     }
 
     // default values for the parameters are set here. Should be removed eventually!!
-    exposure_time_ = 0 ; // default as 0 = auto exposure
     soft_framerate_ = 20; //default soft framrate
-    gain_ = 0;
     ext_ = ".bmp";
     SOFT_FRAME_RATE_CTRL_ = false;
     LIVE_ = false;
@@ -91,16 +120,52 @@ void acquisition::Capture::init_variables_register_to_ros() {
     trigger_capture_ = false;
     EXPORT_TO_ROS_ = false;
     PUBLISH_CAM_INFO_ = false;
+    PUBLISH_FRAME_SET_ = false;
+    PUBLISH_COMPRESSED_ = false;
+    CHUNK_DATA_ = false;
+    compressed_format_ = "jpeg";
+    compressed_quality_ = 80;
+    compressed_rate_ = 0;
+    compressed_threads_ = 2;
+    clock_sync_interval_ = 1.0;
+    sync_tolerance_ = -1;
+    sync_window_ = 3;
+    trigger_window_ = -1;
+    init_threads_ = 4;
+    hotplug_interval_ = 1.0;
+    frame_source_ = "spinnaker";
+    synthetic_width_ = 1440;
+    synthetic_height_ = 1080;
+    synthetic_rate_ = 30;
+    synthetic_jitter_ = 0;
+    synthetic_drops_ = "";
+    replay_path_ = "";
+    stats_interval_ = 1.0;
+    diagnostics_interval_ = 1.0;
+    stream_stats_interval_ = 5.0;
+    trace_events_ = 0;
+    trace_file_ = (boost::filesystem::temp_directory_path() / "spinnaker_trace.json").string();
+    FORCE_FLUSH_ = false;
+    buffer_count_ = 0;
+    usb_bandwidth_ = 0;
+    pause_acquisition_ = 0;
+    buffer_latency_ = 1.0;
+    buffer_memory_ = 1024;
+    buffer_handling_mode_ = "OldestFirst";
+    USER_SET_ = false;
+    user_set_ = "UserSet1";
+    user_set_cache_ = "~/.ros/spinnaker_user_sets";
+    PARTIAL_SETS_ = true;
+    MASTER_CAM_ = 0;
     SAVE_ = false;
     SAVE_BIN_ = false;
     nframes_ = -1;
     FIXED_NUM_FRAMES_ = false;
     MAX_RATE_SAVE_ = false;
-    region_of_interest_set_ = false;
+    LIMIT_MASTER_RATE_ = false;
     skip_num_ = 20;
     init_delay_ = 1;
     master_fps_ = 20.0;
-    binning_ = 1;
     SPINNAKER_GET_NEXT_IMAGE_TIMEOUT_ = 2000;
     todays_date_ = todays_date();
     
@@ -114,7 +179,6 @@ void acquisition::Capture::init_variables_register_to_ros() {
     toMat_time_ = 0;
     save_mat_time_ = 0;
     export_to_ROS_time_ = 0;
-    achieved_time_ = 0;
 
     // decimation_ = 1;
 
@@ -128,11 +192,11 @@ void acquisition::Capture::init_variables_register_to_ros() {
     GRID_CREATED_ = false;
     VERIFY_BINNING_ = false;
     
-    //GPS Data
-    nmea_trigger = boost::none;
-
     //read_settings(config_file);
     read_parameters();
+    // the trace buffers of threads are sized as they start, before the first one does
+    if (trace_events_ > 0)
+        enable_tracing(trace_events_);
 
     // Retrieve singleton reference to system object
     ROS_INFO_STREAM("*** SYSTEM INFORMATION ***");
@@ -150,33 +214,57 @@ void acquisition::Capture::init_variables_register_to_ros() {
     software_trigger_sub_ = nh_.subscribe("/ImageCollection/software_trigger", 1000, &acquisition::Capture::assignSoftwareTriggerCallback,this);
 
     load_cameras();
+    memory_.init(numCameras_, NUM_MEMORY_STAGES);
 
     //initializing the ros publisher
     acquisition_pub = nh_.advertise<spinnaker_sdk_camera_driver::SpinnakerImageNames>("camera", 1000);
+    if (PUBLISH_FRAME_SET_)
+        frame_set_pub_ = nh_.advertise<spinnaker_sdk_camera_driver::SpinnakerImageSet>("camera_array/frame_set", 1);
+    if (PUBLISH_COMPRESSED_)
+        compressed_pub_.init(nh_, vector<string>(cam_names_.begin(), cam_names_.begin() + numCameras_),
+                             compressed_threads_, compressed_format_, compressed_quality_, compressed_rate_);
+    if (stats_interval_ > 0) {
+        array_stage_stats_pub_ = nh_.advertise<spinnaker_sdk_camera_driver::StageStats>("camera_array/stage_stats", 10);
+        last_stats_ = ros::WallTime::now();
+        stats_timer_ = nh_.createWallTimer(ros::WallDuration(stats_interval_), &acquisition::Capture::publish_stage_stats, this);
+    }
+    if (diagnostics_interval_ > 0) {
+        diagnostics_pub_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+        last_diagnostics_ = ros::WallTime::now();
+        diagnostics_timer_ = nh_.createWallTimer(ros::WallDuration(diagnostics_interval_), &acquisition::Capture::publish_diagnostics, this);
+    }
     
     
     //dynamic reconfigure
-    dynamicReCfgServer_ = new dynamic_reconfigure::Server<spinnaker_sdk_camera_driver::spinnaker_camConfig>(nh_pvt_);
+    dynamicReCfgServer_ = new dynamic_reconfigure::Server<spinnaker_sdk_camera_driver::spinnaker_camConfig>(config_mutex_, nh_pvt_);
     
     dynamic_reconfigure::Server<spinnaker_sdk_camera_driver::spinnaker_camConfig>::CallbackType dynamicReCfgServerCB_t;   
 
     dynamicReCfgServerCB_t = boost::bind(&acquisition::Capture::dynamicReconfigureCallback,this, _1, _2);
     dynamicReCfgServer_->setCallback(dynamicReCfgServerCB_t);
+    image_format_srv_ = nh_pvt_.advertiseService("set_image_format", &acquisition::Capture::setImageFormatCallback, this);
+    dump_trace_srv_ = nh_pvt_.advertiseService("dump_trace", &acquisition::Capture::dumpTraceCallback, this);
 
 }
 void acquisition::Capture::load_cameras() {
 
-    // Retrieve list of cameras from the system
-    ROS_INFO_STREAM("Retreiving list of cameras...");
-    camList_ = system_->GetCameras();
+    vector<acquisition::Camera> found;
+    if (frame_source_ == "spinnaker") {
+        // Retrieve list of cameras from the system
+        ROS_INFO_STREAM("Retreiving list of cameras...");
+        camList_ = system_->GetCameras();
+        for (int i=0; i<camList_.GetSize(); i++)
+            found.push_back(acquisition::Camera(camList_.GetByIndex(i)));
+    } else
+        found = simulated_cameras();
     
-    numCameras_ = camList_.GetSize();
+    numCameras_ = found.size();
     ROS_ASSERT_MSG(numCameras_,"No cameras found!");
     ROS_INFO_STREAM("Numer of cameras found: " << numCameras_);
     ROS_INFO_STREAM(" Cameras connected: " << numCameras_);
 
     for (int i=0; i<numCameras_; i++) {
-        acquisition::Camera cam(camList_.GetByIndex(i));
+        acquisition::Camera& cam = found[i];
         ROS_INFO_STREAM("  -"<< cam.get_id()
                              <<" "<< cam.getTLNodeStringValue("DeviceModelName")
                              <<" "<< cam.getTLNodeStringValue("DeviceVersion") );
@@ -184,14 +272,22 @@ void acquisition::Capture::load_cameras() {
 
     bool master_set = false;
     int cam_counter = 0;
+    array_times_.reset(new StageTimes());
+    array_times_->frames = 0;
+    array_times_->queue_size = 0;
+    // index in cam_ids of each camera in cams
+    vector<int> configured;
     
     for (int j=0; j<cam_ids_.size(); j++) {
         bool current_cam_found=false;
         for (int i=0; i<numCameras_; i++) {
         
-            acquisition::Camera cam(camList_.GetByIndex(i));
+            acquisition::Camera cam = found[i];
             if (!EXTERNAL_TRIGGER_ and !CODE_TRIGGER_){
                 cam.setGetNextImageTimeout(SPINNAKER_GET_NEXT_IMAGE_TIMEOUT_);  // set to finite number when not using external triggering
+            } else {
+                // waiting for a trigger may take forever, a reconfiguration or the hot-plug watchdog calls it off
+                cam.set_grab_abort([this]() { return pause_acquisition_ > 0 || !ros::ok(); });
             }
 
             if (cam.get_id().compare(cam_ids_[j]) == 0) {
@@ -207,14 +303,39 @@ void acquisition::Capture::load_cameras() {
 
                 Mat img;
                 frames_.push_back(img);
+                frame_memory_.push_back(MemoryTokenPtr());
                 time_stamps_.push_back("");
+                frame_ids_.push_back(0);
+                stamps_.push_back(ros::Time(0));
+                device_stamps_.push_back(0);
+                ChunkMetadata no_chunk;
+                no_chunk.valid = false;
+                chunks_.push_back(no_chunk);
+                clock_syncs_.push_back(std::shared_ptr<ClockSync>(new ClockSync()));
+                std::shared_ptr<CameraState> state(new CameraState());
+                state->online = true;
+                state->rejoined = false;
+                state->outages = 0;
+                state->outage_secs = 0;
+                state->queue_drops = 0;
+                state->save_failures = 0;
+                stream_counters_.push_back(StreamCounters());
+                camera_states_.push_back(state);
         
                 cams.push_back(cam);
+                configured.push_back(j);
                 
                 camera_image_pubs.push_back(it_->advertiseCamera("camera_array/"+cam_names_[j]+"/image_raw", 1));
                 camera_image_gps_pubs.push_back(nh_.advertise<msgs_and_srvs::GpsTaggedImageMsg>("camera_array/"+cam_names_[j]+"/gps_image",1,true));
                 camera_fps_pub = nh_.advertise<std_msgs::Float64>("camera_array/camera_fps",1,true);
                 benchmark_pubs.push_back(nh_.advertise<msgs_and_srvs::CollectionBenchmarkMsg>("camera_array/"+cam_names_[j]+"/benchmark",1,true));
+                stage_stats_pubs_.push_back(nh_.advertise<spinnaker_sdk_camera_driver::StageStats>("camera_array/"+cam_names_[j]+"/stage_stats",10));
+                std::shared_ptr<StageTimes> times(new StageTimes());
+                times->frames = 0;
+                times->queue_size = 0;
+                camera_times_.push_back(times);
+                if (CHUNK_DATA_)
+                    frame_metadata_pubs_.push_back(nh_.advertise<spinnaker_sdk_camera_driver::FrameMetadata>("camera_array/"+cam_names_[j]+"/frame_metadata",10));
 
                 img_msgs.push_back(sensor_msgs::ImagePtr());
 
@@ -233,17 +354,6 @@ void acquisition::Capture::load_cameras() {
 
                 // distortion
                 ci_msg->distortion_model = distortion_model;
-                // binning
-                ci_msg->binning_x = binning_;
-                ci_msg->binning_y = binning_;
-                
-                if (region_of_interest_set_ && (region_of_interest_width_!=0 || region_of_interest_height_!=0)){
-                    ci_msg->roi.do_rectify = true;
-                    ci_msg->roi.width = region_of_interest_width_;
-                    ci_msg->roi.height = region_of_interest_height_;
-                    ci_msg->roi.x_offset = region_of_interest_x_offset_;
-                    ci_msg->roi.y_offset = region_of_interest_y_offset_;
-                }
             
                 if (PUBLISH_CAM_INFO_){
                     ci_msg->D = distortion_coeff_vec_[j];
@@ -293,6 +403,34 @@ void acquisition::Capture::load_cameras() {
     // Setting numCameras_ variable to reflect number of camera objects used.
     // numCameras_ variable is used in other methods where it means size of cams list.
     numCameras_ = cams.size();
+    // from here on the per camera settings are indexed like cams, configured cameras that are missing are left out
+    keep_connected(cam_settings_, configured);
+    keep_connected(cam_names_, configured);
+    keep_connected(flip_horizontal_vec_, configured);
+    keep_connected(flip_vertical_vec_, configured);
+    for (int sink = 0; sink < SinkDecimator::NUM_SINKS; sink++) {
+        keep_connected(sink_every_[sink], configured);
+        keep_connected(sink_rate_[sink], configured);
+    }
+    // binning and region of interest
+    update_camera_info();
+
+    decimator_.init(numCameras_);
+    sink_masks_.assign(numCameras_, 0);
+    for (int sink = 0; sink < SinkDecimator::NUM_SINKS; sink++) {
+        for (int i = 0; i < numCameras_; i++) {
+            int every = sink_every_[sink][i];
+            double rate = sink_rate_[sink][i];
+            // a frame set needs the images of all cameras, so the master's ROS decimation applies to all of them
+            if (PUBLISH_FRAME_SET_ && sink == SinkDecimator::SINK_ROS) {
+                every = sink_every_[sink][MASTER_CAM_];
+                rate = sink_rate_[sink][MASTER_CAM_];
+            }
+            decimator_.set(SinkDecimator::Sink(sink), i, every, rate);
+        }
+    }
+    init_frame_set_assembly();
+
     // setting PUBLISH_CAM_INFO_ to true so export to ros method can publish it_.advertiseCamera msg with zero intrisics and distortion coeffs.
     PUBLISH_CAM_INFO_ = true;
 
@@ -300,6 +438,47 @@ void acquisition::Capture::load_cameras() {
         ROS_ASSERT_MSG(master_set,"The camera supposed to be the master isn't connected!");
 }
 
+// One simulated camera per entry of cam_ids, all on one trigger line like the wired array
+vector<acquisition::Camera> acquisition::Capture::simulated_cameras() {
+
+    ROS_INFO_STREAM("Creating " << cam_ids_.size() << " " << frame_source_ << " cameras...");
+    std::shared_ptr<SimulatedTriggerLine> line(new SimulatedTriggerLine(synthetic_rate_));
+    vector<acquisition::Camera> found;
+    for (int j = 0; j < cam_ids_.size(); j++) {
+        std::shared_ptr<FrameSource> source;
+        if (frame_source_ == "replay")
+            source.reset(new ReplaySource(cam_ids_[j], replay_path_ + "/" + cam_names_[j], line,
+                                          synthetic_rate_, synthetic_jitter_, synthetic_drops_));
+        else
+            source.reset(new SyntheticSource(cam_ids_[j], line, synthetic_width_, synthetic_height_,
+                                             synthetic_rate_, synthetic_jitter_, synthetic_drops_));
+        found.push_back(acquisition::Camera(source));
+    }
+    return found;
+
+}
+
+void acquisition::Capture::init_frame_set_assembly() {
+
+    // without a given tolerance allow a quarter of the frame period between the cameras of a set
+    double fps = frame_rate();
+    double tolerance = sync_tolerance_;
+    if (tolerance < 0)
+        tolerance = fps > 0 ? 0.25 / fps : 0;
+    // matching by timestamp needs all cameras on one clock, without clock sync the stamps are arrival times
+    if (tolerance > 0 && clock_sync_interval_ <= 0) {
+        ROS_WARN("  Camera clock sync is off, frames of a set are matched by frame ID");
+        tolerance = 0;
+    }
+
+    // trigger messages are matched to the sets by the master's timestamp, default is half the frame period
+    double window = trigger_window_ >= 0 ? trigger_window_ : (fps > 0 ? 0.5 / fps : 0.05);
+    trigger_queue_.set_window(int64_t(window * 1e9));
+
+    grab_assembler_.init(numCameras_, MASTER_CAM_, int64_t(tolerance * 1e9), sync_window_, PARTIAL_SETS_);
+    queue_assembler_.init(numCameras_, MASTER_CAM_, int64_t(tolerance * 1e9), sync_window_, PARTIAL_SETS_);
+}
+
 void acquisition::Capture::read_parameters() {
 
     ROS_INFO_STREAM("*** PARAMETER SETTINGS ***");
@@ -383,9 +562,12 @@ void acquisition::Capture::read_parameters() {
     } 
         else ROS_WARN("  'utstamps' Parameter not set, using default behavior utstamps=%s",!MASTER_TIMESTAMP_FOR_ALL_?"true":"false");
     
-    if (nh_pvt_.getParam("color", color_)) 
-        ROS_INFO("  color set to: %s",color_?"true":"false");
-        else ROS_WARN("  'color' Parameter not set, using default behavior color=%s",color_?"true":"false");
+    vector<bool> colors;
+    if (read_per_camera_param("color", colors, false)) {
+        for (int i=0; i<colors.size(); i++)
+            ROS_INFO_STREAM("  "<<cam_ids_[i] << " color " << colors[i]);
+    }
+        else ROS_WARN("  'color' Parameter not set, using default behavior color=false");
         
     if (nh_pvt_.getParam("flip_horizontal", flip_horizontal_vec_)){
         ROS_ASSERT_MSG(num_ids == flip_horizontal_vec_.size(),"If flip_horizontal flags are provided, they should be the same number as cam_ids and should correspond in order!");
@@ -419,6 +601,38 @@ void acquisition::Capture::read_parameters() {
         ROS_INFO("  Exporting images to ROS: %s",EXPORT_TO_ROS_?"true":"false");
         else ROS_WARN("  'to_ros' Parameter not set, using default behavior to_ros=%s",EXPORT_TO_ROS_?"true":"false");
 
+    if (nh_pvt_.getParam("frame_set", PUBLISH_FRAME_SET_)) 
+        ROS_INFO("  Publishing synchronized frame sets: %s",PUBLISH_FRAME_SET_?"true":"false");
+        else ROS_WARN("  'frame_set' Parameter not set, using default behavior frame_set=%s",PUBLISH_FRAME_SET_?"true":"false");
+
+    if (nh_pvt_.getParam("compressed", PUBLISH_COMPRESSED_)) 
+        ROS_INFO("  Publishing compressed images: %s",PUBLISH_COMPRESSED_?"true":"false");
+        else ROS_WARN("  'compressed' Parameter not set, using default behavior compressed=%s",PUBLISH_COMPRESSED_?"true":"false");
+
+    if (PUBLISH_COMPRESSED_){
+        if (nh_pvt_.getParam("compressed_format", compressed_format_)){
+            if (compressed_format_.compare("jpeg") == 0 || compressed_format_.compare("png") == 0)
+                ROS_INFO_STREAM("    compressed_format set to: "<<compressed_format_);
+            else {
+                compressed_format_ = "jpeg";
+                ROS_WARN_STREAM("    Provided 'compressed_format' is not jpeg or png, using default behavior compressed_format="<<compressed_format_);
+            }
+        } else ROS_WARN_STREAM("    'compressed_format' Parameter not set, using default behavior compressed_format="<<compressed_format_);
+
+        if (!nh_pvt_.getParam("compressed_quality", compressed_quality_))
+            compressed_quality_ = compressed_format_.compare("png") == 0 ? 3 : 80;
+        ROS_INFO("    compressed_quality set to: %d",compressed_quality_);
+
+        if (nh_pvt_.getParam("compressed_rate", compressed_rate_))
+            ROS_INFO("    compressed_rate limit set to: %.1f Hz",compressed_rate_);
+        else ROS_WARN("    'compressed_rate' Parameter not set, using default behavior: no rate limit");
+
+        if (nh_pvt_.getParam("compressed_threads", compressed_threads_)){
+            if (compressed_threads_ < 1) compressed_threads_ = 1;
+            ROS_INFO("    compressed_threads set to: %d",compressed_threads_);
+        } else ROS_WARN("    'compressed_threads' Parameter not set, using default behavior compressed_threads=%d",compressed_threads_);
+    }
+
     if (nh_pvt_.getParam("live", LIVE_)) 
         ROS_INFO("  Showing live images setting: %s",LIVE_?"true":"false");
         else ROS_WARN("  'live' Parameter not set, using default behavior live=%s",LIVE_?"true":"false");
@@ -436,6 +650,30 @@ void acquisition::Capture::read_parameters() {
         ROS_INFO("  Displaying timing details: %s",TIME_BENCHMARK_?"true":"false");
         else ROS_WARN("  'time' Parameter not set, using default behavior time=%s",TIME_BENCHMARK_?"true":"false");
 
+    if (nh_pvt_.getParam("stats_interval", stats_interval_)){
+        if (stats_interval_ > 0) ROS_INFO("  Timing statistics published every: %0.2f sec",stats_interval_);
+        else ROS_INFO("  'stats_interval'=%0.2f, timing statistics are not published",stats_interval_);
+    } else ROS_WARN("  'stats_interval' Parameter not set, using default behavior: stats_interval=%0.2f sec",stats_interval_);
+
+    if (nh_pvt_.getParam("diagnostics_interval", diagnostics_interval_)){
+        if (diagnostics_interval_ > 0) ROS_INFO("  Diagnostics published every: %0.2f sec",diagnostics_interval_);
+        else ROS_INFO("  'diagnostics_interval'=%0.2f, diagnostics are not published",diagnostics_interval_);
+    } else ROS_WARN("  'diagnostics_interval' Parameter not set, using default behavior: diagnostics_interval=%0.2f sec",diagnostics_interval_);
+
+    if (nh_pvt_.getParam("stream_stats_interval", stream_stats_interval_)){
+        if (stream_stats_interval_ > 0) ROS_INFO("  Transport layer stream counters read every: %0.2f sec",stream_stats_interval_);
+        else ROS_INFO("  'stream_stats_interval'=%0.2f, transport layer stream counters are not read",stream_stats_interval_);
+    } else ROS_WARN("  'stream_stats_interval' Parameter not set, using default behavior: stream_stats_interval=%0.2f sec",stream_stats_interval_);
+
+    if (nh_pvt_.getParam("trace_events", trace_events_)){
+        if (trace_events_ > 0) ROS_INFO("  Tracing the last %d events of each thread",trace_events_);
+        else ROS_INFO("  'trace_events'=%d, tracing is off",trace_events_);
+    } else ROS_WARN("  'trace_events' Parameter not set, using default behavior: trace_events=%d",trace_events_);
+
+    if (nh_pvt_.getParam("trace_file", trace_file_)){
+        ROS_INFO("  Trace file: %s",trace_file_.c_str());
+    } else ROS_WARN("  'trace_file' Parameter not set, using default behavior: trace_file=%s",trace_file_.c_str());
+
     if (nh_pvt_.getParam("skip", skip_num_)){
         if (skip_num_ >0) ROS_INFO("  No. of images to skip set to: %d",skip_num_);
         else {
@@ -444,8 +682,133 @@ void acquisition::Capture::read_parameters() {
         }
     } else ROS_WARN("  'skip' Parameter not set, using default behavior: skip=%d",skip_num_);
 
+    sink_every_.resize(SinkDecimator::NUM_SINKS);
+    sink_rate_.resize(SinkDecimator::NUM_SINKS);
+    for (int sink = 0; sink < SinkDecimator::NUM_SINKS; sink++) {
+        string sink_name = SinkDecimator::name(SinkDecimator::Sink(sink));
+        bool every_set = read_per_camera_param(sink_name + "_every", sink_every_[sink], 1);
+        bool rate_set = read_per_camera_param(sink_name + "_rate", sink_rate_[sink], 0.0);
+        if (every_set || rate_set) {
+            for (int i=0; i<cam_ids_.size(); i++)
+                ROS_INFO_STREAM("  "<<cam_ids_[i]<<" "<<sink_name<<" every "<<sink_every_[sink][i]<<" frame(s)"
+                                <<(sink_rate_[sink][i] > 0 ? ", max "+to_string(sink_rate_[sink][i])+" Hz" : ""));
+        } else ROS_DEBUG_STREAM("  '"<<sink_name<<"_every'/'"<<sink_name<<"_rate' Parameters not set, "<<sink_name<<" takes every frame");
+    }
+
+    if (nh_pvt_.getParam("chunk_data", CHUNK_DATA_)){
+        ROS_INFO("  Per frame chunk data (exposure, gain, timestamp, frame ID) %s",CHUNK_DATA_?"enabled":"disabled");
+    } else ROS_WARN("  'chunk_data' Parameter not set, using default behavior: chunk_data=%s",CHUNK_DATA_?"true":"false");
+
+    if (nh_pvt_.getParam("clock_sync_interval", clock_sync_interval_)){
+        if (clock_sync_interval_ > 0) ROS_INFO("  Camera clock sync interval set to: %0.2f sec",clock_sync_interval_);
+        else ROS_INFO("  'clock_sync_interval'=%0.2f, camera clock sync off, images stamped on arrival",clock_sync_interval_);
+    } else ROS_WARN("  'clock_sync_interval' Parameter not set, using default behavior: clock_sync_interval=%0.2f sec",clock_sync_interval_);
+
+    if (nh_pvt_.getParam("sync_tolerance", sync_tolerance_)){
+        if (sync_tolerance_ > 0) ROS_INFO("  Frames of a set matched by timestamp within: %0.4f sec",sync_tolerance_);
+        else ROS_INFO("  'sync_tolerance'=%0.4f, frames of a set matched by frame ID",sync_tolerance_);
+    } else ROS_WARN("  'sync_tolerance' Parameter not set, using default behavior: a quarter of the frame period");
+
+    if (nh_pvt_.getParam("sync_window", sync_window_)){
+        ROS_INFO("  Incomplete frame sets given up after: %d newer master frames",sync_window_);
+    } else ROS_WARN("  'sync_window' Parameter not set, using default behavior: sync_window=%d",sync_window_);
+
+    if (nh_pvt_.getParam("partial_sets", PARTIAL_SETS_)){
+        ROS_INFO("  Incomplete frame sets are %s",PARTIAL_SETS_?"still put out":"dropped");
+    } else ROS_WARN("  'partial_sets' Parameter not set, using default behavior: partial_sets=%s",PARTIAL_SETS_?"true":"false");
+
+    if (nh_pvt_.getParam("trigger_window", trigger_window_)){
+        ROS_INFO("  Trigger messages matched to images within: %0.4f sec",trigger_window_);
+    } else ROS_WARN("  'trigger_window' Parameter not set, using default behavior: half the frame period");
+
+    if (nh_pvt_.getParam("init_threads", init_threads_)){
+        ROS_INFO("  Cameras initialized up to %d at a time per USB controller",init_threads_);
+    } else ROS_WARN("  'init_threads' Parameter not set, using default behavior: init_threads=%d",init_threads_);
+
+    if (nh_pvt_.getParam("buffer_count", buffer_count_)){
+        if (buffer_count_ > 0) ROS_INFO("  Stream buffers per camera: %d",buffer_count_);
+        else ROS_INFO("  'buffer_count'=%d, stream buffers are sized automatically",buffer_count_);
+    } else ROS_WARN("  'buffer_count' Parameter not set, using default behavior: stream buffers are sized automatically");
+
+    if (nh_pvt_.getParam("buffer_latency", buffer_latency_)){
+        ROS_INFO("  Stream buffers hold frames for: %0.2f sec",buffer_latency_);
+    } else ROS_WARN("  'buffer_latency' Parameter not set, using default behavior: buffer_latency=%0.2f sec",buffer_latency_);
+
+    if (nh_pvt_.getParam("buffer_memory", buffer_memory_)){
+        ROS_INFO("  Stream buffers of all cameras limited to: %0.0f MB",buffer_memory_);
+    } else ROS_WARN("  'buffer_memory' Parameter not set, using default behavior: buffer_memory=%0.0f MB",buffer_memory_);
+
+    if (nh_pvt_.getParam("buffer_handling_mode", buffer_handling_mode_)){
+        ROS_INFO_STREAM("  Stream buffer handling mode: " << buffer_handling_mode_);
+    } else ROS_WARN_STREAM("  'buffer_handling_mode' Parameter not set, using default behavior: buffer_handling_mode=" << buffer_handling_mode_);
+
+    if (nh_pvt_.getParam("usb_bandwidth", usb_bandwidth_)){
+        if (usb_bandwidth_ > 0) ROS_INFO("  Bandwidth per USB controller: %0.0f MB/s",usb_bandwidth_);
+        else ROS_INFO("  'usb_bandwidth'=%0.0f, camera bandwidth is not limited",usb_bandwidth_);
+    } else ROS_WARN("  'usb_bandwidth' Parameter not set, using default behavior: camera bandwidth is not limited");
+
+    if (nh_pvt_.getParam("hotplug_interval", hotplug_interval_)){
+        if (hotplug_interval_ > 0) ROS_INFO("  Camera connections checked every: %0.2f sec",hotplug_interval_);
+        else ROS_INFO("  'hotplug_interval'=%0.2f, unplugged cameras are not recovered",hotplug_interval_);
+    } else ROS_WARN("  'hotplug_interval' Parameter not set, using default behavior: hotplug_interval=%0.2f sec",hotplug_interval_);
+
+    if (nh_pvt_.getParam("frame_source", frame_source_)){
+        ROS_INFO_STREAM("  Images from: " << frame_source_);
+        if (frame_source_ != "spinnaker" && frame_source_ != "synthetic" && frame_source_ != "replay") {
+            ROS_WARN_STREAM("  Unknown frame_source " << frame_source_ << ", using spinnaker");
+            frame_source_ = "spinnaker";
+        }
+    } else ROS_WARN_STREAM("  'frame_source' Parameter not set, using default behavior: frame_source=" << frame_source_);
+
+    if (frame_source_ != "spinnaker") {
+        nh_pvt_.getParam("synthetic_width", synthetic_width_);
+        nh_pvt_.getParam("synthetic_height", synthetic_height_);
+        ROS_INFO("  Simulated sensor size: %dx%d",synthetic_width_,synthetic_height_);
+
+        if (nh_pvt_.getParam("synthetic_rate", synthetic_rate_)){
+            ROS_INFO("  Simulated cameras run at up to: %0.1f fps",synthetic_rate_);
+        } else ROS_WARN("  'synthetic_rate' Parameter not set, using default behavior: synthetic_rate=%0.1f fps",synthetic_rate_);
+
+        if (nh_pvt_.getParam("synthetic_jitter", synthetic_jitter_)){
+            ROS_INFO("  Simulated images delayed by up to: %0.2f ms",synthetic_jitter_);
+        } else ROS_WARN("  'synthetic_jitter' Parameter not set, using default behavior: synthetic_jitter=%0.2f ms",synthetic_jitter_);
+
+        if (nh_pvt_.getParam("synthetic_drops", synthetic_drops_)){
+            ROS_INFO_STREAM("  Simulated frame drop pattern: " << synthetic_drops_);
+        } else ROS_WARN("  'synthetic_drops' Parameter not set, using default behavior: no frames dropped");
+
+        if (nh_pvt_.getParam("replay_path", replay_path_)){
+            ROS_INFO_STREAM("  Replaying images from: " << replay_path_);
+        } else if (frame_source_ == "replay")
+            ROS_ERROR("  'replay_path' Parameter not set, there are no images to replay");
+    }
+
+    if (nh_pvt_.getParam("force_flush", FORCE_FLUSH_)){
+        ROS_INFO("  Flush sequence %s",FORCE_FLUSH_?"always run":"skipped for cameras in a clean state");
+    } else ROS_WARN("  'force_flush' Parameter not set, using default behavior: force_flush=%s",FORCE_FLUSH_?"true":"false");
+
+    if (nh_pvt_.getParam("user_set", USER_SET_)){
+        ROS_INFO("  Configuration %s saved on the cameras for fast restarts",USER_SET_?"is":"isn't");
+    } else ROS_WARN("  'user_set' Parameter not set, using default behavior: user_set=%s",USER_SET_?"true":"false");
+
+    if (nh_pvt_.getParam("user_set_name", user_set_)){
+        ROS_INFO_STREAM("  Camera user set for the configuration: " << user_set_);
+    } else ROS_DEBUG_STREAM("  'user_set_name' Parameter not set, using default behavior: user_set_name=" << user_set_);
+
+    if (nh_pvt_.getParam("user_set_cache", user_set_cache_)){
+        ROS_INFO_STREAM("  Hashes of the saved configurations kept in: " << user_set_cache_);
+    } else ROS_DEBUG_STREAM("  'user_set_cache' Parameter not set, using default behavior: user_set_cache=" << user_set_cache_);
+    if (user_set_cache_.front() == '~') {
+        const char *homedir;
+        if ((homedir = getenv("HOME")) == NULL)
+            homedir = getpwuid(getuid())->pw_dir;
+        user_set_cache_.replace(0, 1, homedir);
+    }
+    if (USER_SET_)
+        read_user_set_cache();
+
     if (nh_pvt_.getParam("delay", init_delay_)){
-        if (init_delay_>=0) ROS_INFO("  Init sleep delays set to : %0.2f sec",init_delay_);
+        if (init_delay_>=0) ROS_INFO("  Max wait for each flush step set to : %0.2f sec",init_delay_);
         else {
             init_delay_=1;
             ROS_WARN("  Provided 'delay' is not valid, using default behavior, delay=%f",init_delay_);
@@ -461,16 +824,22 @@ void acquisition::Capture::read_parameters() {
     }
         else ROS_WARN("  'fps' Parameter not set, using default behavior: fps=%0.2f",master_fps_);
 
-    if (nh_pvt_.getParam("exposure_time", exposure_time_)){
-        if (exposure_time_ >0) ROS_INFO("  Exposure set to: %.1f",exposure_time_);
-        else ROS_INFO("  'exposure_time'=%0.f, Setting autoexposure",exposure_time_);
+    vector<float> exposure_times;
+    if (read_per_camera_param("exposure_time", exposure_times, 0.0f)){
+        for (int i=0; i<exposure_times.size(); i++) {
+            if (exposure_times[i] >0) ROS_INFO("  %s Exposure set to: %.1f",cam_ids_[i].c_str(),exposure_times[i]);
+            else ROS_INFO("  %s 'exposure_time'=%0.f, Setting autoexposure",cam_ids_[i].c_str(),exposure_times[i]);
+        }
     } else ROS_WARN("  'exposure_time' Parameter not set, using default behavior: Automatic Exposure ");
 
-    if(nh_pvt_.getParam("gain", gain_)){
-       if(gain_>0){
-          ROS_INFO("gain value set to:%.1f",gain_);
-       }
-       else ROS_INFO("  'gain' Parameter was zero or negative, using Auto gain based on target grey value");
+    vector<float> gains;
+    if(read_per_camera_param("gain", gains, 0.0f)){
+        for (int i=0; i<gains.size(); i++) {
+            if(gains[i]>0){
+                ROS_INFO("  %s gain value set to:%.1f",cam_ids_[i].c_str(),gains[i]);
+            }
+            else ROS_INFO("  %s 'gain' Parameter was zero or negative, using Auto gain based on target grey value",cam_ids_[i].c_str());
+        }
     } 
     else ROS_WARN("  'gain' Parameter not set, using default behavior: Auto gain based on target grey value");
 
@@ -480,13 +849,16 @@ void acquisition::Capture::read_parameters() {
     else ROS_WARN("  'target_grey_value' Parameter not set, using default behavior: AutoExposureTargetGreyValueAuto to auto");
 
 
-    if (nh_pvt_.getParam("binning", binning_)){
-        if (binning_ >0) ROS_INFO("  Binning set to: %d",binning_);
-        else {
-            binning_=1;
-            ROS_INFO("  'binning'=%d invalid, Using defauly binning=",binning_);
+    vector<int> binnings;
+    if (read_per_camera_param("binning", binnings, 1)){
+        for (int i=0; i<binnings.size(); i++) {
+            if (binnings[i] >0) ROS_INFO("  %s Binning set to: %d",cam_ids_[i].c_str(),binnings[i]);
+            else {
+                ROS_INFO("  %s 'binning'=%d invalid, Using default binning=1",cam_ids_[i].c_str(),binnings[i]);
+                binnings[i]=1;
+            }
         }
-    } else ROS_WARN("  'binning' Parameter not set, using default behavior: Binning = %d",binning_);
+    } else ROS_WARN("  'binning' Parameter not set, using default behavior: Binning = 1");
 
     if (nh_pvt_.getParam("soft_framerate", soft_framerate_)){
         if (soft_framerate_ >0) {
@@ -524,27 +896,46 @@ void acquisition::Capture::read_parameters() {
     }
     else ROS_WARN("  'tf_prefix' Parameter not set, using default behavior tf_prefix=" " ");
 
+    bool roi_set = false;
+    vector<int> roi_widths, roi_heights, roi_x_offsets, roi_y_offsets;
     if (nh_pvt_.hasParam("region_of_interest")){
-        region_of_interest_set_ = true;
-        if (!nh_pvt_.getParam("region_of_interest/width", region_of_interest_width_)){
-            region_of_interest_set_ = false;
+        // each field is either one value for all cameras or a list in cam_ids order
+        roi_set = true;
+        if (!read_per_camera_param("region_of_interest/width", roi_widths, 0)){
+            roi_set = false;
             }
-        if (!nh_pvt_.getParam("region_of_interest/height", region_of_interest_height_)){
-            region_of_interest_set_ = false;
+        if (!read_per_camera_param("region_of_interest/height", roi_heights, 0)){
+            roi_set = false;
             }
-        if (!nh_pvt_.getParam("region_of_interest/x_offset", region_of_interest_x_offset_)){
-            region_of_interest_set_ = false;
+        if (!read_per_camera_param("region_of_interest/x_offset", roi_x_offsets, 0)){
+            roi_set = false;
             }
-        if (!nh_pvt_.getParam("region_of_interest/y_offset", region_of_interest_y_offset_)){
-            region_of_interest_set_ = false;
+        if (!read_per_camera_param("region_of_interest/y_offset", roi_y_offsets, 0)){
+            roi_set = false;
             }
         
-        if (region_of_interest_set_){
-            ROS_INFO("  Region of Interest set to width: %d\theight: %d\toffset_x: %d offset_y: %d",
-                     region_of_interest_width_, region_of_interest_height_, region_of_interest_x_offset_, region_of_interest_y_offset_);
+        if (roi_set){
+            for (int i=0; i<cam_ids_.size(); i++)
+                ROS_INFO("  %s Region of Interest set to width: %d\theight: %d\toffset_x: %d offset_y: %d", cam_ids_[i].c_str(),
+                         roi_widths[i], roi_heights[i], roi_x_offsets[i], roi_y_offsets[i]);
         } else ROS_ERROR("  'region_of_interest' Parameter found but not configured correctly, NOT BEING USED");
     } else ROS_INFO_STREAM("  'region of interest' not set using full resolution");
 
+    cam_settings_.clear();
+    for (int i=0; i<cam_ids_.size(); i++) {
+        CameraSettings settings;
+        settings.exposure_time = exposure_times[i];
+        settings.gain = gains[i];
+        settings.binning = binnings[i];
+        settings.color = colors[i];
+        settings.roi_set = roi_set;
+        settings.roi_width = roi_set ? roi_widths[i] : 0;
+        settings.roi_height = roi_set ? roi_heights[i] : 0;
+        settings.roi_x_offset = roi_set ? roi_x_offsets[i] : 0;
+        settings.roi_y_offset = roi_set ? roi_y_offsets[i] : 0;
+        cam_settings_.push_back(settings);
+    }
+
     bool intrinsics_list_provided = false;
     XmlRpc::XmlRpcValue intrinsics_list;
     if (nh_pvt_.getParam("intrinsic_coeffs", intrinsics_list)) {
@@ -636,146 +1027,434 @@ void acquisition::Capture::read_parameters() {
 }
 
 
+// Polls until ready(i) holds for all cameras or init_delay_ secs passed, logs how long it took
+bool acquisition::Capture::wait_for_cameras(const char* phase, const boost::function<bool(int)>& ready) {
+
+    ros::WallTime start = ros::WallTime::now();
+    bool all_ready = false;
+    while (!all_ready) {
+        all_ready = true;
+        for (int i = 0; i < numCameras_ && all_ready; i++)
+            all_ready = ready(i);
+        if (all_ready || (ros::WallTime::now() - start).toSec() > init_delay_)
+            break;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    double elapsed = (ros::WallTime::now() - start).toSec()*1000;
+    if (all_ready)
+        ROS_INFO("  Flush: %s after %.0f ms", phase, elapsed);
+    else
+        ROS_WARN("  Flush: cameras not %s after %.0f ms, continuing", phase, elapsed);
+    return all_ready;
+
+}
+
 void acquisition::Capture::init_array() {
     
     ROS_INFO_STREAM("*** FLUSH SEQUENCE ***");
+    ros::WallTime start = ros::WallTime::now();
 
     init_cameras(true);
 
-    start_acquisition();
-    sleep(init_delay_*0.5);
+    bool clean = !FORCE_FLUSH_;
+    for (int i = 0; i < numCameras_ && clean; i++)
+        clean = cams[i].is_clean();
 
-    end_acquisition();
-    sleep(init_delay_*0.5);
+    // cameras left acquiring by a previous run are cycled once to get rid of stale buffers and settings
+    if (clean) {
+        ROS_INFO_STREAM("  Flush: all cameras report a clean state, skipping flush");
+    } else {
+        start_acquisition();
+        wait_for_cameras("streaming", [this](int i) { return cams[i].is_streaming(); });
 
-    deinit_cameras();
-    sleep(init_delay_*2.0);
+        int drained = 0;
+        for (int i = 0; i < numCameras_; i++)
+            drained += cams[i].drain_buffers();
+        ROS_INFO("  Flush: %d stale image(s) drained", drained);
+
+        end_acquisition();
+        wait_for_cameras("stopped", [this](int i) { return !cams[i].is_streaming(); });
+
+        deinit_cameras();
+    }
 
     init_cameras(false);
 
-    ROS_DEBUG_STREAM("Flush sequence done.");
+    ROS_INFO("Flush sequence done in %.0f ms.", (ros::WallTime::now() - start).toSec()*1000);
+
+}
+
+void acquisition::Capture::for_each_camera(const boost::function<void(int)>& task) {
+
+    // cameras on one USB host controller share its bandwidth and are set up a few at a time, controllers in parallel;
+    // cameras whose controller is unknown count as one controller
+    map<string, vector<int> > controllers;
+    for (int i = numCameras_-1 ; i >=0 ; i--)
+        controllers[BandwidthPlanner::usb_controller(cams[i].get_id())].push_back(i);
+
+    int num_threads = 0;
+    for (map<string, vector<int> >::iterator it = controllers.begin(); it != controllers.end(); ++it)
+        num_threads += min(init_threads_, (int)it->second.size());
+    if (num_threads <= 1) {
+        for (int i = numCameras_-1 ; i >=0 ; i--)
+            task(i);
+        return;
+    }
+
+    boost::thread_group threads;
+    for (map<string, vector<int> >::iterator it = controllers.begin(); it != controllers.end(); ++it) {
+        const vector<int>& group = it->second;
+        std::shared_ptr< std::atomic<size_t> > group_next(new std::atomic<size_t>(0));
+        for (int t = 0; t < min(init_threads_, (int)group.size()); t++)
+            threads.create_thread([&task, &group, group_next]() {
+                for (size_t k = (*group_next)++; k < group.size(); k = (*group_next)++)
+                    task(group[k]);
+            });
+    }
+    threads.join_all();
 
 }
 
 void acquisition::Capture::init_cameras(bool soft = false) {
 
     ROS_INFO_STREAM("Initializing cameras...");
-    
-    // Set cameras 1 to 4 to continuous
-    for (int i = numCameras_-1 ; i >=0 ; i--) {
-                                
-        ROS_DEBUG_STREAM("Initializing camera " << cam_ids_[i] << "...");
+    ros::WallTime start = ros::WallTime::now();
 
-        try {
-            
-            cams[i].init();
+    for_each_camera([this, soft](int i) {
+        if (!configure_camera(i, soft))
+            ros::shutdown();
+    });
+    if (!soft)
+        plan_bandwidth();
 
-            if (!soft) {
-                cams[i].setBufferSize(100);
-                cams[i].set_color(color_);
-                cams[i].setIntValue("BinningHorizontal", binning_);
-                cams[i].setIntValue("BinningVertical", binning_);                
-                cams[i].setEnumValue("ExposureMode", "Timed");
-                cams[i].setBoolValue("ReverseX", flip_horizontal_vec_[i]);
-                cams[i].setBoolValue("ReverseY", flip_vertical_vec_[i]);
-                
-                if (region_of_interest_set_){
-                    if (region_of_interest_width_ != 0)
-                        cams[i].setIntValue("Width", region_of_interest_width_);
-                    if (region_of_interest_height_ != 0)
-                        cams[i].setIntValue("Height", region_of_interest_height_);
-                    cams[i].setIntValue("OffsetX", region_of_interest_x_offset_);
-                    cams[i].setIntValue("OffsetY", region_of_interest_y_offset_);
-                }
-                
-                if (exposure_time_ > 0) { 
-                    cams[i].setEnumValue("ExposureAuto", "Off");
-                    cams[i].setFloatValue("ExposureTime", exposure_time_);
-                } else {
-                    cams[i].setEnumValue("ExposureAuto", "Continuous");
-                }
-                
-                if(gain_>0){ //fixed gain
-                    cams[i].setEnumValue("GainAuto", "Off");
-                    double max_gain_allowed = cams[i].getFloatValueMax("Gain");
-                    if (gain_ <= max_gain_allowed)
-                        cams[i].setFloatValue("Gain", gain_);
-                    else {
-                        cams[i].setFloatValue("Gain", max_gain_allowed);
-                        ROS_WARN("Provided Gain value is higher than max allowed, setting gain to %f", max_gain_allowed);
-                    }
-                    target_grey_value_ = 50;
-                } else {
-                    cams[i].setEnumValue("GainAuto","Continuous");                   
-                }
+    ROS_INFO("All cameras initialized in %.0f ms", (ros::WallTime::now() - start).toSec()*1000);
+}
 
-                if (target_grey_value_ > 4.0) {
-                    cams[i].setEnumValue("AutoExposureTargetGreyValueAuto", "Off");
-                    cams[i].setFloatValue("AutoExposureTargetGreyValue", target_grey_value_);
-                } else {
-                    cams[i].setEnumValue("AutoExposureTargetGreyValueAuto", "Continuous");
-                }
+bool acquisition::Capture::configure_camera(int i, bool soft) {
 
-                // cams[i].setIntValue("DecimationHorizontal", decimation_);
-                // cams[i].setIntValue("DecimationVertical", decimation_);
-                // cams[i].setFloatValue("AcquisitionFrameRate", 5.0);
+    ros::WallTime start = ros::WallTime::now();
+    ROS_DEBUG_STREAM("Initializing camera " << cams[i].get_id() << "...");
 
-                if (color_)
-                        cams[i].setEnumValue("PixelFormat", "BayerRG8");
-                    else
-                        cams[i].setEnumValue("PixelFormat", "Mono8");
-                
-                cams[i].setEnumValue("AcquisitionMode", "Continuous");
-                
-                // set only master to be software triggered
-                if (cams[i].is_master()) { 
-                    if (MAX_RATE_SAVE_ && !CODE_TRIGGER_){
-                      cams[i].setEnumValue("LineSelector", "Line2");
-                      cams[i].setEnumValue("LineMode", "Output");
-                      cams[i].setBoolValue("AcquisitionFrameRateEnable", false);
-                      //cams[i].setFloatValue("AcquisitionFrameRate", 170);
-                    } else{
-                      cams[i].setEnumValue("TriggerMode", "On");
-                      cams[i].setEnumValue("LineSelector", "Line2");
-                      cams[i].setEnumValue("LineMode", "Output");
-                      cams[i].setEnumValue("TriggerSource", "Software");
-                    }
-                    //cams[i].setEnumValue("LineSource", "ExposureActive");
-
-
-                } else{ // sets the configuration for external trigger: used for all slave cameras 
-                        // in master slave setup. Also in the mode when another sensor such as IMU triggers 
-                        // the camera
-                    cams[i].setEnumValue("TriggerMode", "On");
-                    cams[i].setEnumValue("LineSelector", "Line3");
-                    cams[i].setEnumValue("TriggerSource", "Line3");
-                    cams[i].setEnumValue("TriggerSelector", "FrameStart");
-                    cams[i].setEnumValue("LineMode", "Input");
-                    
-//                    cams[i].setFloatValue("TriggerDelay", 40.0);
-                    cams[i].setEnumValue("TriggerOverlap", "ReadOut");//"Off"
-                    cams[i].setEnumValue("TriggerActivation", "RisingEdge");
-                }
-            }
+    try {
         
+        cams[i].init();
+
+        if (!soft) {
+            cams[i].set_color(cam_settings_[i].color);
+            // a configuration saved on the camera by an earlier run is loaded in one go
+            if (!load_user_set(i)) {
+                apply_configuration(i);
+                save_user_set(i);
+            }
+            // sized for the image size that was just configured
+            configure_buffers(i);
+            // a reconnected camera gets the share of its controller it had before
+            int64_t limit = bandwidth_planner_.limit(i);
+            if (limit > 0)
+                cams[i].setThroughputLimit(limit);
         }
+    
+    }
 
-        catch (Spinnaker::Exception &e) {
-            string error_msg = e.what();
-            ROS_FATAL_STREAM("Error: " << error_msg);
-            if (error_msg.find("Unable to set PixelFormat to BGR8") >= 0)
-              ROS_WARN("Most likely cause for this error is if your camera can't support color and your are trying to set it to color mode");
-            ros::shutdown();
+    catch (Spinnaker::Exception &e) {
+        string error_msg = e.what();
+        ROS_FATAL_STREAM("Error: " << error_msg);
+        if (error_msg.find("Unable to set PixelFormat to BGR8") >= 0)
+          ROS_WARN("Most likely cause for this error is if your camera can't support color and your are trying to set it to color mode");
+        return false;
+    }
+
+    ROS_INFO("  Camera %s %s in %.0f ms", cams[i].get_id().c_str(), soft ? "initialized" : "configured",
+             (ros::WallTime::now() - start).toSec()*1000);
+    return true;
+}
+
+// Sizes the host side image buffers of camera i to cover buffer_latency secs of frames within the memory budget
+void acquisition::Capture::configure_buffers(int i) {
+
+    if (!buffer_handling_mode_.empty())
+        cams[i].setBufferHandlingMode(buffer_handling_mode_);
+
+    int64_t payload = cams[i].getPayloadSize();
+    int count = buffer_count_;
+    if (count <= 0) {
+        double fps = frame_rate();
+        // one buffer being filled by the camera and one held by the driver on top of the latency budget
+        count = (int)ceil(max(fps, 1.0) * buffer_latency_) + 2;
+        if (payload > 0 && buffer_memory_ > 0) {
+            double share = buffer_memory_ * 1024 * 1024 / numCameras_;
+            int affordable = (int)(share / payload);
+            if (affordable < count)
+                ROS_WARN_STREAM("  Camera " << cams[i].get_id() << ": buffer_memory allows only " << affordable
+                                << " of " << count << " buffers for " << buffer_latency_ << " sec");
+            count = min(count, affordable);
+        }
+        count = max(count, 3);
+    }
+
+    count = cams[i].setBufferSize(count);
+    if (count > 0)
+        ROS_INFO("  Camera %s: %d buffers of %.1f MB (%.0f MB), %s", cams[i].get_id().c_str(), count,
+                 payload / 1048576.0, count * payload / 1048576.0,
+                 buffer_handling_mode_.empty() ? "default handling mode" : buffer_handling_mode_.c_str());
+
+}
+
+// Shares the bandwidth of each USB controller between its cameras with DeviceLinkThroughputLimit
+void acquisition::Capture::plan_bandwidth() {
+
+    if (usb_bandwidth_ <= 0)
+        return;
+
+    double fps = frame_rate();
+    bandwidth_planner_.set_controller_bandwidth(usb_bandwidth_ * 1e6);
+    for (int i = 0; i < numCameras_; i++) {
+        if (!camera_online(i))
+            continue;
+        string controller = BandwidthPlanner::usb_controller(cams[i].get_id());
+        if (controller.empty())
+            ROS_WARN_STREAM("  Camera " << cams[i].get_id() << ": USB controller not found, bandwidth not limited");
+        bandwidth_planner_.add(i, controller, cams[i].getPayloadSize() * fps);
+    }
+    bandwidth_planner_.plan();
+
+    const map<string, double>& loads = bandwidth_planner_.controller_loads();
+    for (map<string, double>::const_iterator it = loads.begin(); it != loads.end(); ++it) {
+        if (it->second > usb_bandwidth_ * 1e6)
+            ROS_WARN("  USB controller %s: cameras need %.0f MB/s at %.1f fps, more than the %.0f MB/s available",
+                     it->first.c_str(), it->second / 1e6, fps, usb_bandwidth_);
+        else
+            ROS_INFO("  USB controller %s: cameras need %.0f of %.0f MB/s",
+                     it->first.c_str(), it->second / 1e6, usb_bandwidth_);
+    }
+
+    for (int i = 0; i < numCameras_; i++) {
+        int64_t limit = bandwidth_planner_.limit(i);
+        if (limit <= 0 || !camera_online(i))
+            continue;
+        limit = cams[i].setThroughputLimit(limit);
+        int64_t payload = cams[i].getPayloadSize();
+        if (limit <= 0 || payload <= 0)
+            continue;
+        double max_fps = (double)limit / payload;
+        if (max_fps < fps)
+            ROS_WARN("  Camera %s: limited to %.0f MB/s, at most %.1f of %.1f fps", cams[i].get_id().c_str(),
+                     limit / 1e6, max_fps, fps);
+        else
+            ROS_INFO("  Camera %s: limited to %.0f MB/s", cams[i].get_id().c_str(), limit / 1e6);
+    }
+
+}
+
+// Hash of everything apply_configuration() writes to camera i, changes whenever a parameter or the driver changes
+string acquisition::Capture::configuration_hash(int i) {
+
+    ostringstream config;
+    const CameraSettings& settings = cam_settings_[i];
+    config << spinnaker_sdk_camera_driver_VERSION << ";" << cams[i].get_model() << ";" << settings.color << ";" << settings.binning
+           << ";" << flip_horizontal_vec_[i] << ";" << flip_vertical_vec_[i] << ";" << CHUNK_DATA_
+           << ";" << settings.roi_set << ";" << settings.roi_width << ";" << settings.roi_height
+           << ";" << settings.roi_x_offset << ";" << settings.roi_y_offset
+           << ";" << settings.exposure_time << ";" << settings.gain << ";" << target_grey_value_
+           << ";" << cams[i].is_master() << ";" << MAX_RATE_SAVE_ << ";" << CODE_TRIGGER_ << ";" << EXTERNAL_TRIGGER_
+           << ";" << SOFT_FRAME_RATE_CTRL_ << ";" << master_fps_ << ";" << LIMIT_MASTER_RATE_;
+
+    // 64 bit FNV-1a, stable across builds unlike std::hash
+    uint64_t hash = 14695981039346656037ull;
+    string key = config.str();
+    for (int k = 0; k < key.size(); k++) {
+        hash ^= (unsigned char)key[k];
+        hash *= 1099511628211ull;
+    }
+    ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+
+}
+
+void acquisition::Capture::read_user_set_cache() {
+
+    std::ifstream file(user_set_cache_.c_str());
+    string serial, hash;
+    while (file >> serial >> hash)
+        user_set_hashes_[serial] = hash;
+    ROS_DEBUG_STREAM("  " << user_set_hashes_.size() << " saved camera configuration(s) in " << user_set_cache_);
+
+}
+
+bool acquisition::Capture::load_user_set(int i) {
+
+    if (!USER_SET_)
+        return false;
+
+    string hash = configuration_hash(i);
+    user_set_mutex_.lock();
+    bool saved = user_set_hashes_.count(cams[i].get_id()) && user_set_hashes_[cams[i].get_id()] == hash;
+    user_set_mutex_.unlock();
+    if (!saved) {
+        ROS_INFO_STREAM("  Camera " << cams[i].get_id() << ": configuration changed since it was saved, configuring in full");
+        return false;
+    }
+    if (!cams[i].load_user_set(user_set_))
+        return false;
+
+    // the chunk flag of the camera object isn't part of the user set
+    if (CHUNK_DATA_)
+        cams[i].enableChunkData();
+    ROS_INFO_STREAM("  Camera " << cams[i].get_id() << ": configuration loaded from " << user_set_);
+    return true;
+
+}
+
+void acquisition::Capture::save_user_set(int i) {
+
+    if (!USER_SET_ || !cams[i].save_user_set(user_set_))
+        return;
+
+    boost::mutex::scoped_lock lock(user_set_mutex_);
+    user_set_hashes_[cams[i].get_id()] = configuration_hash(i);
+    std::ofstream file(user_set_cache_.c_str());
+    for (map<string, string>::iterator it = user_set_hashes_.begin(); it != user_set_hashes_.end(); ++it)
+        file << it->first << " " << it->second << "\n";
+    if (!file)
+        ROS_WARN_STREAM("  Could not write the saved configurations to " << user_set_cache_);
+    else
+        ROS_INFO_STREAM("  Camera " << cams[i].get_id() << ": configuration saved to " << user_set_);
+
+}
+
+// Binning, region of interest and pixel format, the settings that can only change while the camera is not acquiring
+void acquisition::Capture::apply_image_format(int i) {
+
+    const CameraSettings& settings = cam_settings_[i];
+
+    // offsets first, so that the new size fits whatever region was set before
+    cams[i].setIntValue("OffsetX", 0);
+    cams[i].setIntValue("OffsetY", 0);
+    cams[i].setIntValue("BinningHorizontal", settings.binning);
+    cams[i].setIntValue("BinningVertical", settings.binning);
+
+    bool roi = settings.roi_set;
+    cams[i].setIntValue("Width", roi && settings.roi_width != 0 ? settings.roi_width : cams[i].getIntValueMax("Width"));
+    cams[i].setIntValue("Height", roi && settings.roi_height != 0 ? settings.roi_height : cams[i].getIntValueMax("Height"));
+    if (roi) {
+        cams[i].setIntValue("OffsetX", settings.roi_x_offset);
+        cams[i].setIntValue("OffsetY", settings.roi_y_offset);
+    }
+
+    if (settings.color)
+        cams[i].setEnumValue("PixelFormat", "BayerRG8");
+    else
+        cams[i].setEnumValue("PixelFormat", "Mono8");
+
+}
+
+void acquisition::Capture::update_camera_info() {
+
+    for (int i = 0; i < cam_info_msgs.size(); i++) {
+        const CameraSettings& settings = cam_settings_[i];
+        sensor_msgs::CameraInfoPtr ci_msg = cam_info_msgs[i];
+        ci_msg->binning_x = settings.binning;
+        ci_msg->binning_y = settings.binning;
+
+        ci_msg->roi = sensor_msgs::RegionOfInterest();
+        if (settings.roi_set && (settings.roi_width!=0 || settings.roi_height!=0)){
+            ci_msg->roi.do_rectify = true;
+            ci_msg->roi.width = settings.roi_width;
+            ci_msg->roi.height = settings.roi_height;
+            ci_msg->roi.x_offset = settings.roi_x_offset;
+            ci_msg->roi.y_offset = settings.roi_y_offset;
+        }
+    }
+
+}
+
+void acquisition::Capture::apply_configuration(int i) {
+
+    apply_image_format(i);
+    cams[i].setEnumValue("ExposureMode", "Timed");
+    cams[i].setBoolValue("ReverseX", flip_horizontal_vec_[i]);
+    cams[i].setBoolValue("ReverseY", flip_vertical_vec_[i]);
+    if (CHUNK_DATA_)
+        cams[i].enableChunkData();
+    
+    const CameraSettings& settings = cam_settings_[i];
+    if (settings.exposure_time > 0) { 
+        cams[i].setEnumValue("ExposureAuto", "Off");
+        cams[i].setFloatValue("ExposureTime", settings.exposure_time);
+    } else {
+        cams[i].setEnumValue("ExposureAuto", "Continuous");
+    }
+    
+    if(settings.gain>0){ //fixed gain
+        cams[i].setEnumValue("GainAuto", "Off");
+        double max_gain_allowed = cams[i].getFloatValueMax("Gain");
+        if (settings.gain <= max_gain_allowed)
+            cams[i].setFloatValue("Gain", settings.gain);
+        else {
+            cams[i].setFloatValue("Gain", max_gain_allowed);
+            ROS_WARN("Provided Gain value is higher than max allowed, setting gain to %f", max_gain_allowed);
         }
+    } else {
+        cams[i].setEnumValue("GainAuto","Continuous");                   
+    }
 
+    // a fixed gain overrides the target grey value
+    double target_grey_value = settings.gain > 0 ? 50 : target_grey_value_;
+    if (target_grey_value > 4.0) {
+        cams[i].setEnumValue("AutoExposureTargetGreyValueAuto", "Off");
+        cams[i].setFloatValue("AutoExposureTargetGreyValue", target_grey_value);
+    } else {
+        cams[i].setEnumValue("AutoExposureTargetGreyValueAuto", "Continuous");
     }
-    ROS_DEBUG_STREAM("All cameras initialized.");
+
+    // cams[i].setIntValue("DecimationHorizontal", decimation_);
+    // cams[i].setIntValue("DecimationVertical", decimation_);
+    // cams[i].setFloatValue("AcquisitionFrameRate", 5.0);
+
+    cams[i].setEnumValue("AcquisitionMode", "Continuous");
+    
+    // set only master to be software triggered
+    if (cams[i].is_master()) { 
+        if (MAX_RATE_SAVE_ && !CODE_TRIGGER_){
+          cams[i].setEnumValue("LineSelector", "Line2");
+          cams[i].setEnumValue("LineMode", "Output");
+          // a rate set at runtime outlasts a reconnect
+          cams[i].setBoolValue("AcquisitionFrameRateEnable", LIMIT_MASTER_RATE_);
+          if (LIMIT_MASTER_RATE_)
+              cams[i].setFloatValue("AcquisitionFrameRate", master_fps_);
+          //cams[i].setFloatValue("AcquisitionFrameRate", 170);
+        } else{
+          cams[i].setEnumValue("TriggerMode", "On");
+          cams[i].setEnumValue("LineSelector", "Line2");
+          cams[i].setEnumValue("LineMode", "Output");
+          cams[i].setEnumValue("TriggerSource", "Software");
+        }
+        //cams[i].setEnumValue("LineSource", "ExposureActive");
+
+
+    } else{ // sets the configuration for external trigger: used for all slave cameras 
+            // in master slave setup. Also in the mode when another sensor such as IMU triggers 
+            // the camera
+        cams[i].setEnumValue("TriggerMode", "On");
+        cams[i].setEnumValue("LineSelector", "Line3");
+        cams[i].setEnumValue("TriggerSource", "Line3");
+        cams[i].setEnumValue("TriggerSelector", "FrameStart");
+        cams[i].setEnumValue("LineMode", "Input");
+        
+//                    cams[i].setFloatValue("TriggerDelay", 40.0);
+        cams[i].setEnumValue("TriggerOverlap", "ReadOut");//"Off"
+        cams[i].setEnumValue("TriggerActivation", "RisingEdge");
+    }
+
 }
 
 void acquisition::Capture::start_acquisition() {
 
     for (int i = numCameras_-1; i>=0; i--)
-        cams[i].begin_acquisition();
+        if (camera_online(i))
+            cams[i].begin_acquisition();
 
     // for (int i=0; i<numCameras_; i++)
     //     cams[i].begin_acquisition();
@@ -785,7 +1464,8 @@ void acquisition::Capture::start_acquisition() {
 void acquisition::Capture::end_acquisition() {
 
     for (int i = 0; i < numCameras_; i++)
-        cams[i].end_acquisition();
+        if (camera_online(i))
+            cams[i].end_acquisition();
     
 }
 
@@ -795,12 +1475,13 @@ void acquisition::Capture::deinit_cameras() {
 
     // end_acquisition();
     
-    for (int i = numCameras_-1 ; i >=0 ; i--) {
-
+    for_each_camera([this](int i) {
+        if (!camera_online(i))
+            return;
         ROS_DEBUG_STREAM("Camera "<<i<<": Deinit...");
         cams[i].deinit();
         // pCam = NULL;
-    }
+    });
     ROS_INFO_STREAM("All cameras deinitialized."); 
 
 }
@@ -838,6 +1519,9 @@ void acquisition::Capture::save_mat_frames(int dump) {
             
         } else {
 
+            if (!SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_SAVE))
+                continue;
+
             if (MASTER_TIMESTAMP_FOR_ALL_)
                 timestamp = time_stamps_[MASTER_CAM_];
             else
@@ -848,30 +1532,29 @@ void acquisition::Capture::save_mat_frames(int dump) {
             ROS_DEBUG_STREAM("Saving image at " << filename.str());
             //ros image names 
             mesg.name.push_back(filename.str());
-            imwrite(filename.str(), frames_[i]);
+            TraceScope trace("save", i, frame_ids_[i]);
+            if (!imwrite(filename.str(), frames_[i])) {
+                camera_states_[i]->save_failures++;
+                ROS_WARN_STREAM("Could not save image " << filename.str());
+                continue;
+            }
+            trace.end();
+            TraceScope exif_trace("exif", i, frame_ids_[i]);
             try {
                 boost::property_tree::ptree ptree;
                 ptree.put("camera.easting", 123123123);
                 ptree.put("camera.northing", 123123123);
                 ptree.put("camera.altitude", 123123123);
                 ptree.put("camera.zone", 12);
-
-                std::ofstream file;
-	            std::ostringstream oss;
-
-	            boost::property_tree::write_json(oss, ptree);
-
-                Exiv2::ExifData exif_data;
-                exif_data["Exif.Image.Model"] = "Test 1";  
-                exif_data["Exif.Image.ImageDescription"] = oss.str(); 
-                Exiv2::Image::UniquePtr image_exif_file = Exiv2::ImageFactory::open(filename.str());
-                image_exif_file->setExifData(exif_data);
-				image_exif_file->writeMetadata();
+                put_time_metadata(ptree, device_stamps_[i], stamps_[i]);
+                put_chunk_metadata(ptree, chunks_[i]);
+                write_exif_metadata(filename.str(), ptree);
 
             }
             catch( const Exiv2::AnyError& ex )
             {
                 // ROS_ERROR("Could not write the exif data to '%s' -- %s", filename.str(), ex.what());
+                camera_states_[i]->save_failures++;
                 ROS_WARN("Could not write the exif data - %s",ex.what());
                 
             }
@@ -880,6 +1563,7 @@ void acquisition::Capture::save_mat_frames(int dump) {
     }
     
     save_mat_time_ = ros::Time::now().toSec() - t;
+    record_stage(*array_times_, STAGE_SAVE, save_mat_time_);
     
 }
 
@@ -894,18 +1578,115 @@ void acquisition::Capture::export_to_ROS() {
     else frame_id_prefix="";
 
     for (unsigned int i = 0; i < numCameras_; i++) {
+        if (!SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_ROS))
+            continue;
+
+        TraceScope trace("publish", i, frame_ids_[i]);
         img_msg_header.frame_id = frame_id_prefix + "cam_"+to_string(i)+"_optical_frame";
+        img_msg_header.stamp = MASTER_TIMESTAMP_FOR_ALL_ ? stamps_[MASTER_CAM_] : stamps_[i];
         cam_info_msgs[i]->header = img_msg_header;
 
-        if(color_)
+        if(cam_settings_[i].color)
             img_msgs[i]=cv_bridge::CvImage(img_msg_header, "bgr8", frames_[i]).toImageMsg();
         else
             img_msgs[i]=cv_bridge::CvImage(img_msg_header, "mono8", frames_[i]).toImageMsg();
 
         camera_image_pubs[i].publish(img_msgs[i],cam_info_msgs[i]);
+        if (CHUNK_DATA_)
+            publish_frame_metadata(i, chunks_[i], img_msg_header);
 
     }
-    export_to_ROS_time_ = ros::Time::now().toSec()-t;;
+    export_to_ROS_time_ = ros::Time::now().toSec()-t;
+    record_stage(*array_times_, STAGE_EXPORT, export_to_ROS_time_);
+}
+
+void acquisition::Capture::publish_frame_set() {
+
+    // all cameras share the master's ROS decimation while frame sets are published
+    if (!SinkDecimator::takes(sink_masks_[MASTER_CAM_], SinkDecimator::SINK_ROS))
+        return;
+
+    TraceScope trace("publish_set", -1, frame_ids_[MASTER_CAM_]);
+    spinnaker_sdk_camera_driver::SpinnakerImageSetPtr set_msg(new spinnaker_sdk_camera_driver::SpinnakerImageSet());
+    set_msg->header.stamp = stamps_[MASTER_CAM_];
+    set_msg->complete = true;
+
+    string frame_id_prefix;
+    if (tf_prefix_.compare("") != 0)
+        frame_id_prefix = tf_prefix_ +"/";
+    else frame_id_prefix="";
+
+    set_msg->camera_names.resize(numCameras_);
+    set_msg->frame_ids.resize(numCameras_);
+    set_msg->images.resize(numCameras_);
+    set_msg->camera_infos.resize(numCameras_);
+
+    for (unsigned int i = 0; i < numCameras_; i++) {
+        std_msgs::Header img_msg_header;
+        img_msg_header.stamp = MASTER_TIMESTAMP_FOR_ALL_ ? stamps_[MASTER_CAM_] : stamps_[i];
+        img_msg_header.frame_id = frame_id_prefix + "cam_"+to_string(i)+"_optical_frame";
+
+        set_msg->camera_names[i] = cam_names_[i];
+        // cameras missing from a partial set are left empty
+        if (!SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_ROS)) {
+            set_msg->complete = false;
+            continue;
+        }
+        set_msg->frame_ids[i] = frame_ids_[i];
+        // convert straight into the set message, no intermediate per-camera message
+        cv_bridge::CvImage(img_msg_header, cam_settings_[i].color ? "bgr8" : "mono8", frames_[i]).toImageMsg(set_msg->images[i]);
+        set_msg->camera_infos[i] = *cam_info_msgs[i];
+        set_msg->camera_infos[i].header = img_msg_header;
+    }
+
+    frame_set_pub_.publish(set_msg);
+}
+
+void acquisition::Capture::add_to_frame_set(uint64_t set_index, unsigned int set_size, int cam_no, uint64_t frame_id, const Mat& frame, const std_msgs::Header& header) {
+
+    // sets still missing images once this many newer sets are pending are dropped
+    const unsigned int max_pending_sets = 10;
+
+    frame_set_mutex_.lock();
+    map<uint64_t, PendingFrameSet>::iterator it = pending_frame_sets_.find(set_index);
+    if (it == pending_frame_sets_.end()) {
+        PendingFrameSet pending;
+        pending.msg.reset(new spinnaker_sdk_camera_driver::SpinnakerImageSet());
+        pending.msg->header.stamp = header.stamp.isZero() ? ros::Time::now() : header.stamp;
+        pending.msg->camera_names.assign(cam_names_.begin(), cam_names_.begin() + numCameras_);
+        pending.msg->frame_ids.resize(numCameras_);
+        pending.msg->images.resize(numCameras_);
+        pending.msg->camera_infos.resize(numCameras_);
+        pending.msg->complete = set_size == numCameras_;
+        pending.received = 0;
+        it = pending_frame_sets_.insert(make_pair(set_index, pending)).first;
+    }
+    spinnaker_sdk_camera_driver::SpinnakerImageSetPtr set_msg = it->second.msg;
+    frame_set_mutex_.unlock();
+
+    // every writer thread owns its slot of the set, so the image copy happens outside the lock
+    set_msg->frame_ids[cam_no] = frame_id;
+    cv_bridge::CvImage(header, "bgr8", frame).toImageMsg(set_msg->images[cam_no]);
+    set_msg->camera_infos[cam_no] = *cam_info_msgs[cam_no];
+    set_msg->camera_infos[cam_no].header = header;
+
+    bool complete = false;
+    frame_set_mutex_.lock();
+    it = pending_frame_sets_.find(set_index);
+    if (it != pending_frame_sets_.end())
+        it->second.memory.push_back(memory_.hold(cam_no, MEM_FRAME_SET, set_msg->images[cam_no].data.size()));
+    if (it != pending_frame_sets_.end() && ++it->second.received == set_size) {
+        complete = true;
+        pending_frame_sets_.erase(it);
+    }
+    while (pending_frame_sets_.size() > max_pending_sets) {
+        ROS_WARN_STREAM("Dropping incomplete frame set " << pending_frame_sets_.begin()->first);
+        pending_frame_sets_.erase(pending_frame_sets_.begin());
+    }
+    frame_set_mutex_.unlock();
+
+    if (complete)
+        frame_set_pub_.publish(set_msg);
 }
 
 void acquisition::Capture::save_binary_frames(int dump) {
@@ -923,6 +1704,9 @@ void acquisition::Capture::save_binary_frames(int dump) {
             ROS_DEBUG_STREAM("Skipping frame...");
         } else {
 
+            if (!SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_SAVE))
+                continue;
+
             if (MASTER_TIMESTAMP_FOR_ALL_)
                 timestamp = time_stamps_[MASTER_CAM_];
             else
@@ -933,15 +1717,21 @@ void acquisition::Capture::save_binary_frames(int dump) {
             ROS_DEBUG_STREAM("Saving image at " << filename.str());
             //ros image names
             mesg.name.push_back(filename.str());
+            TraceScope trace("save", i, frame_ids_[i]);
             std::ofstream ofs(filename.str());
             boost::archive::binary_oarchive oa(ofs);
             oa << frames_[i];
             ofs.close();
+            if (ofs.fail()) {
+                camera_states_[i]->save_failures++;
+                ROS_WARN_STREAM("Could not save image " << filename.str());
+            }
             
         }
 
     }
     save_mat_time_ = ros::Time::now().toSec() - t;
+    record_stage(*array_times_, STAGE_SAVE, save_mat_time_);
     
 }
 
@@ -966,49 +1756,78 @@ void acquisition::Capture::get_mat_images() {
     //mesg.header.stamp = ros::Time::now();
     //mesg.time = ros::Time::now();
     double t = ros::Time::now().toSec();
-    
-    ostringstream ss;
-    ss<<"frameIDs: [";
-    
-    int frameID;
-    int fid_mismatch = 0;
-   
 
     for (int i=0; i<numCameras_; i++) {
         //ROS_INFO_STREAM("CAM ID IS "<< i);
-        frames_[i] = cams[i].grab_mat_frame();
+        if (!camera_online(i))
+            continue;
+        if (camera_states_[i]->rejoined.exchange(false))
+            grab_assembler_.rejoin(i);
+
+        // decide which outputs take this frame before paying for the conversion
+        GrabbedFrame grabbed;
+        grabbed.sinks = decimator_.select(i, t);
+        TraceScope trace("grab", i);
+        if (!cams[i].grab_mat_frame(grabbed.frame, grabbed.sinks != 0))
+            continue;
+        trace.set_frame_id(cams[i].get_frame_id());
+        trace.end();
+        grabbed.memory = memory_.hold(i, MEM_ASSEMBLING, image_bytes(grabbed.frame));
+        grabbed.time_stamp = cams[i].get_time_stamp();
+        grabbed.device_ns = cams[i].get_timestamp_ns();
+        grabbed.chunk = cams[i].get_chunk_metadata();
         //ROS_INFO("sucess");
-        time_stamps_[i] = cams[i].get_time_stamp();
-
+        grab_assembler_.add(i, cams[i].get_frame_id(), host_time(i, grabbed.device_ns).toNSec(), grabbed);
+    }
 
-        if (i==0)
-            frameID = cams[i].get_frame_id();
-        else
-            if (cams[i].get_frame_id() != frameID)
-                fid_mismatch = 1;
-        
-        if (i == numCameras_-1)
-            ss << cams[i].get_frame_id() << "]";
-        else
-            ss << cams[i].get_frame_id() << ", ";
-        
+    // the outputs only get to see the cameras of a matched set
+    sink_masks_.assign(numCameras_, 0);
+    FrameSet<GrabbedFrame> set;
+    if (grab_assembler_.next(set)) {
+        ostringstream ss;
+        ss<<"frameIDs: [";
+        for (int i=0; i<numCameras_; i++) {
+            if (set.present[i]) {
+                sink_masks_[i] = set.frames[i].sinks;
+                if (sink_masks_[i]) {
+                    frames_[i] = set.frames[i].frame;
+                    // the image moves on from assembling, it is counted in one stage at a time
+                    set.frames[i].memory.reset();
+                    frame_memory_[i] = memory_.hold(i, MEM_CURRENT, image_bytes(frames_[i]));
+                }
+                time_stamps_[i] = set.frames[i].time_stamp;
+                chunks_[i] = set.frames[i].chunk;
+                frame_ids_[i] = set.frame_ids[i];
+                stamps_[i].fromNSec(set.stamps_ns[i]);
+                device_stamps_[i] = set.frames[i].device_ns;
+                ss << set.frame_ids[i];
+            } else
+                ss << "-";
+            ss << (i == numCameras_-1 ? "]" : ", ");
+        }
+        ROS_DEBUG_STREAM(ss.str());
+        ROS_WARN_STREAM_COND(!set.complete, "Incomplete set of images for master frame ID " << set.frame_id << "!");
     }
+    ROS_DEBUG_STREAM("Frame sets complete: " << grab_assembler_.complete_sets() << ", partial: " << grab_assembler_.partial_sets()
+                     << ", frames dropped: " << grab_assembler_.dropped_frames() << ", resyncs: " << grab_assembler_.resyncs());
+    vector<GrabbedFrame> dropped;
+    vector<int> dropped_cams;
+    grab_assembler_.take_dropped(dropped, dropped_cams);
+    count_dropped(dropped_cams);
+
     mesg.header.stamp = ros::Time::now();
     mesg.time = ros::Time::now();
-    string message = ss.str();
-    ROS_DEBUG_STREAM(message);
 
-    if (fid_mismatch)
-        ROS_WARN_STREAM("Frame IDs for grabbed set of images did not match!");
-    
     toMat_time_ = ros::Time::now().toSec() - t;
+    record_stage(*array_times_, STAGE_GRAB, toMat_time_);
     
 }
 
 void acquisition::Capture::run_soft_trig() {
-    achieved_time_ = ros::Time::now().toSec();
     ROS_INFO("*** ACQUISITION ***");
+    trace_thread_name("acquisition");
     
+    boost::mutex::scoped_lock lock(acquisition_mutex_);
     start_acquisition();
 
     // Camera directories created at first save
@@ -1018,7 +1837,7 @@ void acquisition::Capture::run_soft_trig() {
     int count = 0;
     
     if (!EXTERNAL_TRIGGER_) {
-        cams[MASTER_CAM_].trigger();
+        trigger_master();
     }
     
     get_mat_images();
@@ -1034,30 +1853,43 @@ void acquisition::Capture::run_soft_trig() {
     // Gets called only once, when first image is being triggered
         for (unsigned int i = 0; i < numCameras_; i++) {
             //verify if binning is set successfully
-            if (!region_of_interest_set_){
-                ROS_ASSERT_MSG(cams[i].verifyBinning(binning_), " Failed to set Binning= %d, could be either due to Invalid binning value, try changing binning value or due to spinnaker api bug - failing to set lower binning than previously set value - solution: unplug usb camera and re-plug it back and run to node with desired valid binning", binning_);
+            if (!cam_settings_[i].roi_set){
+                ROS_ASSERT_MSG(cams[i].verifyBinning(cam_settings_[i].binning), " Failed to set Binning= %d, could be either due to Invalid binning value, try changing binning value or due to spinnaker api bug - failing to set lower binning than previously set value - solution: unplug usb camera and re-plug it back and run to node with desired valid binning", cam_settings_[i].binning);
             }
             // warn if full sensor resolution is not same as calibration resolution
             cams[i].calibrationParamsTest(image_width_,image_height_);
         }
     VERIFY_BINNING_ = true;
     }
+    lock.unlock();
 
 
     ros::Rate ros_rate(soft_framerate_);
+    int rate = soft_framerate_;
     try{
         while( ros::ok() ) {
 
+            yield_to_reconfiguration();
+            lock.lock();
+            if (soft_framerate_ != rate) {
+                rate = soft_framerate_;
+                ros_rate = ros::Rate(rate);
+            }
+
             double t = ros::Time::now().toSec();
 
-            if (LIVE_) {
+            bool preview = false;
+            for (unsigned int i = 0; i < numCameras_; i++)
+                preview = preview || SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_PREVIEW);
+
+            if (LIVE_ && preview) {
                 if (GRID_VIEW_) {
                     update_grid();
                     imshow("Acquisition", grid_);
-                } else {
+                } else if (SinkDecimator::takes(sink_masks_[CAM_], SinkDecimator::SINK_PREVIEW)) {
                     imshow("Acquisition", frames_[CAM_]);
                     char title[50];
-                    sprintf(title, "cam # = %d, cam ID = %s, cam name = %s", CAM_, cam_ids_[CAM_].c_str(), cam_names_[CAM_].c_str());
+                    sprintf(title, "cam # = %d, cam ID = %s, cam name = %s", CAM_, cams[CAM_].get_id().c_str(), cam_names_[CAM_].c_str());
                     displayOverlay("Acquisition", title);
                 }
             }
@@ -1073,10 +1905,11 @@ void acquisition::Capture::run_soft_trig() {
                     if (CAM_>0)
                         CAM_--;
                 } else if( (key & 255)==84 && MANUAL_TRIGGER_) { // t
-                    cams[MASTER_CAM_].trigger();
+                    trigger_master();
                     get_mat_images();
                 } else if( (key & 255)==32 && !SAVE_) { // SPACE
                     ROS_INFO_STREAM("Saving frame...");
+                    sink_masks_.assign(numCameras_, ~0u);
                     if (SAVE_BIN_)
                         save_binary_frames(0);
                         else{
@@ -1096,16 +1929,17 @@ void acquisition::Capture::run_soft_trig() {
             }
 
             double disp_time_ = ros::Time::now().toSec() - t;
+            record_stage(*array_times_, STAGE_DISPLAY, disp_time_);
 
             // Call update functions
             if (!MANUAL_TRIGGER_) {
                 if (!EXTERNAL_TRIGGER_) {
                     if (!CODE_TRIGGER_) { 
-                        cams[MASTER_CAM_].trigger();
+                        trigger_master();
                         get_mat_images();
                     }else{
                         if (trigger_capture_) {
-                             cams[MASTER_CAM_].trigger();
+                             trigger_master();
                              get_mat_images();
                              trigger_capture_ = false;
                         }
@@ -1132,22 +1966,35 @@ void acquisition::Capture::run_soft_trig() {
             }
 
             if (EXPORT_TO_ROS_) export_to_ROS();
+            if (PUBLISH_FRAME_SET_) publish_frame_set();
+            if (PUBLISH_COMPRESSED_) {
+                string frame_id_prefix;
+                if (tf_prefix_.compare("") != 0)
+                    frame_id_prefix = tf_prefix_ +"/";
+                else frame_id_prefix="";
+
+                for (unsigned int i = 0; i < numCameras_; i++) {
+                    if (!SinkDecimator::takes(sink_masks_[i], SinkDecimator::SINK_ROS))
+                        continue;
+                    std_msgs::Header img_msg_header;
+                    img_msg_header.stamp = MASTER_TIMESTAMP_FOR_ALL_ ? stamps_[MASTER_CAM_] : stamps_[i];
+                    img_msg_header.frame_id = frame_id_prefix + "cam_"+to_string(i)+"_optical_frame";
+                    // the current image and the one being compressed are the same buffer, it counts as compressing
+                    // until both let go of it
+                    frame_memory_[i].reset();
+                    frame_memory_[i] = memory_.hold(i, MEM_COMPRESSING, image_bytes(frames_[i]));
+                    compressed_pub_.enqueue(i, frames_[i], cam_settings_[i].color ? "bgr8" : "mono8", img_msg_header,
+                                            frame_memory_[i]);
+                }
+            }
             //cams[MASTER_CAM_].targetGreyValueTest();
             // ros publishing messages
             acquisition_pub.publish(mesg);
 
-            // double total_time = grab_time_ + toMat_time_ + disp_time_ + save_mat_time_;
-            double total_time = toMat_time_ + disp_time_ + save_mat_time_+export_to_ROS_time_;
-            achieved_time_ = ros::Time::now().toSec() - achieved_time_;
-
-            ROS_INFO_COND(TIME_BENCHMARK_,
-                          "total time (ms): %.1f \tPossible FPS: %.1f\tActual FPS: %.1f",
-                          total_time*1000,1/total_time,1/achieved_time_);
-            
-            ROS_INFO_COND(TIME_BENCHMARK_,"Times (ms):- grab: %.1f, disp: %.1f, save: %.1f, exp2ROS: %.1f",
-                          toMat_time_*1000,disp_time_*1000,save_mat_time_*1000,export_to_ROS_time_*1000);
-            
-            achieved_time_=ros::Time::now().toSec();
+            // timings are summarized every stats_interval by publish_stage_stats()
+            record_stage(*array_times_, STAGE_TOTAL, ros::Time::now().toSec() - t);
+            array_times_->frames.fetch_add(1, std::memory_order_relaxed);
+            lock.unlock();
             
             if (SOFT_FRAME_RATE_CTRL_) {ros_rate.sleep();}
 
@@ -1163,6 +2010,237 @@ void acquisition::Capture::run_soft_trig() {
     //raise(SIGINT);
 }
 
+static const char* STAGE_NAMES[] = {"grab", "convert", "save", "metadata", "export", "display", "total"};
+
+static const char* MEMORY_STAGE_NAMES[] = {"assembling", "queued", "writing", "frame_set", "compressing", "current", "total"};
+
+static void fill_stats(spinnaker_sdk_camera_driver::HistogramStats& out, const string& name, const acquisition::HistogramSummary& summary) {
+
+    out.name = name;
+    out.unit = "ms";
+    out.count = summary.count;
+    out.min = summary.min;
+    out.mean = summary.mean;
+    out.p50 = summary.p50;
+    out.p90 = summary.p90;
+    out.p99 = summary.p99;
+    out.max = summary.max;
+
+}
+
+// Publishes and, with time set, logs the percentiles of the stage timings since the last call
+void acquisition::Capture::publish_stage_stats(const ros::WallTimerEvent&) {
+
+    ros::WallTime now = ros::WallTime::now();
+    double interval = (now - last_stats_).toSec();
+    last_stats_ = now;
+    if (interval <= 0)
+        return;
+
+    if (MAX_RATE_SAVE_) {
+        for (int i = 0; i < camera_times_.size(); i++)
+            publish_stage_stats(cam_names_[i], i, *camera_times_[i], interval, stage_stats_pubs_[i], &benchmark_pubs[i]);
+    } else
+        publish_stage_stats("all", -1, *array_times_, interval, array_stage_stats_pub_, NULL);
+
+}
+
+// cam_no is the camera of per camera timings, -1 for those of the whole array
+void acquisition::Capture::publish_stage_stats(const string& camera, int cam_no, StageTimes& times, double interval,
+                                               ros::Publisher& stats_pub, ros::Publisher* benchmark_pub) {
+
+    spinnaker_sdk_camera_driver::StageStats msg;
+    msg.header.stamp = ros::Time::now();
+    msg.camera = camera;
+    msg.frames = times.frames.exchange(0, std::memory_order_relaxed);
+    msg.fps = msg.frames / interval;
+    msg.queue_size = times.queue_size.load(std::memory_order_relaxed);
+    if (msg.frames == 0)
+        return;
+
+    HistogramSummary summaries[NUM_STAGES];
+    ostringstream log;
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        summaries[stage] = times.stages[stage].summarize(1e-3, true);
+        if (summaries[stage].count == 0)
+            continue;
+        spinnaker_sdk_camera_driver::HistogramStats stats;
+        fill_stats(stats, STAGE_NAMES[stage], summaries[stage]);
+        msg.stages.push_back(stats);
+        char entry[80];
+        snprintf(entry, sizeof(entry), " %s %.1f/%.1f/%.1f", STAGE_NAMES[stage],
+                 summaries[stage].p50, summaries[stage].p99, summaries[stage].max);
+        log << entry;
+    }
+    // the loss counters next to the timings tell a slow host from a lossy link
+    int64_t lost = 0, dropped = 0;
+    for (int i = (cam_no < 0 ? 0 : cam_no); i < (cam_no < 0 ? numCameras_ : cam_no + 1); i++) {
+        msg.streams.push_back(stream_stats(i));
+        lost += max(msg.streams.back().lost_frames, (int64_t)0) + max(msg.streams.back().failed_buffers, (int64_t)0);
+        dropped += max(msg.streams.back().dropped_frames, (int64_t)0) + msg.streams.back().queue_drops;
+    }
+    // image memory of the camera per stage, or of all cameras per stage and per camera
+    int memory_cam = cam_no < 0 ? memory_.all() : cam_no;
+    for (int stage = 0; stage < NUM_MEMORY_STAGES; stage++)
+        if (memory_.max_bytes(memory_cam, stage) > 0)
+            msg.memory.push_back(memory_stats(memory_cam, stage));
+    if (cam_no < 0)
+        for (int i = 0; i < numCameras_; i++)
+            msg.memory.push_back(memory_stats(i, memory_.total()));
+    msg.memory.push_back(memory_stats(memory_cam, memory_.total()));
+    stats_pub.publish(msg);
+
+    // the per camera benchmark topic gets the means of the interval
+    if (benchmark_pub) {
+        msgs_and_srvs::CollectionBenchmarkMsg benchmarkMsg;
+        benchmarkMsg.totalTime = summaries[STAGE_TOTAL].mean;
+        benchmarkMsg.fps = msg.fps;
+        benchmarkMsg.grab = summaries[STAGE_GRAB].mean;
+        benchmarkMsg.save = summaries[STAGE_SAVE].mean;
+        benchmarkMsg.writeMetadata = summaries[STAGE_METADATA].mean;
+        benchmarkMsg.convert = summaries[STAGE_CONVERT].mean;
+        benchmarkMsg.export2Ros = summaries[STAGE_EXPORT].mean;
+        benchmarkMsg.queueSize = (int)msg.queue_size;
+        benchmark_pub->publish(benchmarkMsg);
+    }
+
+    ROS_INFO_COND(TIME_BENCHMARK_, "%s: %.1f FPS, queue %u, lost on link/dropped on host %ld/%ld, "
+                  "image memory %.1f MB (peak %.1f MB, system %.0f%% used), times p50/p99/max (ms):%s",
+                  camera.c_str(), msg.fps, msg.queue_size, (long)lost, (long)dropped, msg.memory.back().bytes / 1e6,
+                  msg.memory.back().peak_bytes / 1e6, mem_usage() * 100, log.str().c_str());
+
+}
+
+void acquisition::Capture::count_dropped(const vector<int>& cams) {
+
+    for (int k = 0; k < cams.size(); k++)
+        camera_states_[cams[k]]->queue_drops++;
+
+}
+
+// One status per camera with its loss counters since the start, WARN while it is losing frames
+void acquisition::Capture::publish_diagnostics(const ros::WallTimerEvent&) {
+
+    static const char* COUNTER_NAMES[] = {"frames", "incomplete", "skipped_ids", "timeouts", "queue_drops", "save_failures"};
+    static const int NUM_COUNTERS = sizeof(COUNTER_NAMES)/sizeof(COUNTER_NAMES[0]);
+
+    ros::WallTime now = ros::WallTime::now();
+    double interval = (now - last_diagnostics_).toSec();
+    last_diagnostics_ = now;
+    last_counts_.resize(numCameras_, vector<uint64_t>(NUM_COUNTERS, 0));
+    last_stream_counters_.resize(numCameras_);
+
+    diagnostic_msgs::DiagnosticArray msg;
+    msg.header.stamp = ros::Time::now();
+    for (int i = 0; i < numCameras_; i++) {
+        const FrameCounters& counters = cams[i].get_counters();
+        const CameraState& state = *camera_states_[i];
+        uint64_t counts[NUM_COUNTERS] = {counters.frames, counters.incomplete, counters.skipped_ids,
+                                         counters.timeouts, state.queue_drops, state.save_failures};
+
+        diagnostic_msgs::DiagnosticStatus status;
+        status.name = "spinnaker_camera: " + cam_names_[i];
+        status.hardware_id = cams[i].get_id();
+        bool losing = false;
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            if (c > 0 && counts[c] > last_counts_[i][c])
+                losing = true;
+            diagnostic_msgs::KeyValue value;
+            value.key = COUNTER_NAMES[c];
+            value.value = to_string(counts[c]);
+            status.values.push_back(value);
+        }
+        diagnostic_msgs::KeyValue fps;
+        fps.key = "fps";
+        char rate[32];
+        snprintf(rate, sizeof(rate), "%.2f", interval > 0 ? (counts[0] - last_counts_[i][0]) / interval : 0.0);
+        fps.value = rate;
+        status.values.insert(status.values.begin(), fps);
+        diagnostic_msgs::KeyValue outages;
+        outages.key = "outages";
+        outages.value = to_string(state.outages);
+        status.values.push_back(outages);
+
+        // frames lost before they reach the host point at the link, frames the host had no room or time for at the host
+        StreamCounters stream = stream_counters(i);
+        StreamCounters& last_stream = last_stream_counters_[i];
+        // a restarted stream starts counting over
+        bool restarted = stream.lost_frames < last_stream.lost_frames || stream.dropped_frames < last_stream.dropped_frames;
+        bool link = !restarted && (stream.lost_frames > last_stream.lost_frames || stream.failed_buffers > last_stream.failed_buffers);
+        bool host = (!restarted && (stream.dropped_frames > last_stream.dropped_frames || stream.buffer_underruns > last_stream.buffer_underruns))
+                    || counts[4] > last_counts_[i][4] || counts[5] > last_counts_[i][5];
+        const char* stream_names[] = {"tl_lost_frames", "tl_failed_buffers", "tl_dropped_frames", "tl_buffer_underruns", "tl_resend_requests"};
+        int64_t stream_values[] = {stream.lost_frames, stream.failed_buffers, stream.dropped_frames, stream.buffer_underruns, stream.resend_requests};
+        for (int c = 0; c < 5; c++) {
+            if (stream_values[c] < 0)
+                continue;
+            diagnostic_msgs::KeyValue value;
+            value.key = stream_names[c];
+            value.value = to_string(stream_values[c]);
+            status.values.push_back(value);
+        }
+        last_stream = stream;
+
+        if (!camera_online(i)) {
+            status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+            status.message = "Camera offline";
+        } else if (losing || link || host) {
+            status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+            if (link && host)
+                status.message = "Losing frames on the link and on the host";
+            else if (link)
+                status.message = "Losing frames on the link";
+            else if (host)
+                status.message = "Losing frames on the host";
+            else
+                status.message = "Losing frames";
+        } else {
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.message = "OK";
+        }
+        msg.status.push_back(status);
+        last_counts_[i].assign(counts, counts + NUM_COUNTERS);
+    }
+    diagnostics_pub_.publish(msg);
+
+}
+
+spinnaker_sdk_camera_driver::MemoryStats acquisition::Capture::memory_stats(int cam, int stage) {
+
+    spinnaker_sdk_camera_driver::MemoryStats stats;
+    stats.camera = cam == memory_.all() ? "all" : cam_names_[cam];
+    stats.stage = MEMORY_STAGE_NAMES[stage];
+    stats.bytes = memory_.bytes(cam, stage);
+    stats.peak_bytes = memory_.take_peak(cam, stage);
+    stats.max_bytes = memory_.max_bytes(cam, stage);
+    return stats;
+
+}
+
+acquisition::StreamCounters acquisition::Capture::stream_counters(int cam_no) {
+
+    boost::mutex::scoped_lock lock(stream_mutex_);
+    return stream_counters_[cam_no];
+
+}
+
+spinnaker_sdk_camera_driver::StreamStats acquisition::Capture::stream_stats(int cam_no) {
+
+    StreamCounters counters = stream_counters(cam_no);
+    spinnaker_sdk_camera_driver::StreamStats stats;
+    stats.camera = cam_names_[cam_no];
+    stats.lost_frames = counters.lost_frames;
+    stats.failed_buffers = counters.failed_buffers;
+    stats.dropped_frames = counters.dropped_frames;
+    stats.buffer_underruns = counters.buffer_underruns;
+    stats.resend_requests = counters.resend_requests;
+    stats.incomplete = cams[cam_no].get_counters().incomplete;
+    stats.skipped_ids = cams[cam_no].get_counters().skipped_ids;
+    stats.queue_drops = camera_states_[cam_no]->queue_drops;
+    return stats;
+
+}
+
 float acquisition::Capture::mem_usage() {
     std::string token;
     std::ifstream file("/proc/meminfo");
@@ -1184,11 +2262,15 @@ float acquisition::Capture::mem_usage() {
 
 void acquisition::Capture::update_grid() {
 
+    TraceScope trace("display");
     if (!GRID_CREATED_) {
         int height = frames_[0].rows;
         int width = frames_[0].cols*cams.size();
         
-        if (color_)
+        bool color = false;
+        for (int i=0; i<cams.size(); i++)
+            color = color || cam_settings_[i].color;
+        if (color)
         grid_.create(height, width, CV_8UC3);
         else
         grid_.create(height, width, CV_8U);
@@ -1196,28 +2278,34 @@ void acquisition::Capture::update_grid() {
         GRID_CREATED_ = true;
     }
 
-    for (int i=0; i<cams.size(); i++)
-        frames_[i].copyTo(grid_.colRange(i*frames_[i].cols,i*frames_[i].cols+frames_[i].cols).rowRange(0,grid_.rows));
+    compose_grid(frames_, grid_);
     
 }
 
 //*** CODE FOR MULTITHREADED WRITING
 void acquisition::Capture::write_queue_to_disk(queue<Metadata>* img_q, int cam_no) {
-    double ml_grab_time_ = 0;
-    double ml_save_time_ = 0;
-    double ml_toMat_time_ = 0;
-    double metadata_write_time_ = 0;
-    double ml_export_to_ROS_time_ = 0;
+    StageTimes& times = *camera_times_[cam_no];
 
     ROS_DEBUG("  Write Queue to Disk Thread Initiated for cam: %d", cam_no);
-    string id = cam_ids_[cam_no];
+    trace_thread_name("writer " + cam_names_[cam_no]);
+    string id = cams[cam_no].get_id();
     int imageCnt =0;
     uint64_t timeStamp = 0;
+    int64_t wait_begin_ns = -1;
     try{
         while( ros::ok() ) {
             double t = ros::Time::now().toSec();
-            if (img_q->size()== 0)
+            if (img_q->size()== 0) {
+                if (wait_begin_ns < 0 && tracing_enabled())
+                    wait_begin_ns = trace_now_ns();
                 continue;
+            }
+            // stages that don't run for this image count as 0 in the total
+            double ml_grab_time_ = 0;
+            double ml_save_time_ = 0;
+            double ml_toMat_time_ = 0;
+            double metadata_write_time_ = 0;
+            double ml_export_to_ROS_time_ = 0;
 
             ROS_DEBUG_STREAM("  Write Queue to Disk for cam: "<< cam_no <<" size = "<<img_q->size());
 
@@ -1226,47 +2314,73 @@ void acquisition::Capture::write_queue_to_disk(queue<Metadata>* img_q, int cam_n
             
             ImagePtr convertedImage = img_q->front().image;
             msgs_and_srvs::ImageTriggerMsg trigger_message = img_q->front().trigger_message;
-            timeStamp =  convertedImage->GetTimeStamp() * 1000;
+            bool trigger_matched = img_q->front().trigger_matched;
+            ros::Time stamp = img_q->front().stamp;
+            unsigned int sinks = img_q->front().sinks;
+            uint64_t set_index = img_q->front().set_index;
+            unsigned int set_size = img_q->front().set_size;
+            int64_t device_ns = img_q->front().device_ns;
+            int frame_id = img_q->front().frame_id;
+            ChunkMetadata chunk = img_q->front().chunk;
+            if (wait_begin_ns >= 0) {
+                trace_event("queue_wait", cam_no, frame_id, wait_begin_ns, trace_now_ns());
+                wait_begin_ns = -1;
+            }
+            queue_mutex_.lock();
+            img_q->front().memory = memory_.hold(cam_no, MEM_WRITING, convertedImage->GetBufferSize());
+            queue_mutex_.unlock();
+            timeStamp = device_ns * 1000;
             // Create a unique filename
             ostringstream filename;
             filename<<path_<<cam_names_[cam_no]<<"/"<<cam_names_[cam_no]
                     <<"_"<<id<<"_"<<todays_date_ << "_"<<std::setfill('0')
                     << std::setw(6) << imageCnt<<"_"<<timeStamp << ext_; 
             ml_grab_time_ = ros::Time::now().toSec() - t;
+            record_stage(times, STAGE_GRAB, ml_grab_time_);
             t = ros::Time::now().toSec();
-            if (SAVE_ ) {
-                convertedImage->Save(filename.str().c_str());
-                ROS_DEBUG_STREAM("Image saved at " << filename.str());
-                ml_save_time_ = ros::Time::now().toSec() - t;
-                t = ros::Time::now().toSec();
-
-                boost::property_tree::ptree ptree;
-                ptree.put("camera.block_name", trigger_message.block_name);
-                ptree.put("camera.cam_no", cam_no);
-                ptree.put("camera.image_number", trigger_message.image_number);
-                ptree.put("camera.lat", trigger_message.lat);
-                ptree.put("camera.lon", trigger_message.lon);
-                ptree.put("camera.utm_x", trigger_message.utm_x);
-                ptree.put("camera.utm_y", trigger_message.utm_y);
-                ptree.put("camera.altitude", trigger_message.altitude);
-                ptree.put("camera.heading", trigger_message.heading);
-
-                std::ofstream file;
-	            std::ostringstream oss;
-
-	            boost::property_tree::write_json(oss, ptree);
-
-                Exiv2::ExifData exif_data;
-                exif_data["Exif.Image.Model"] = "Test 1";  
-                exif_data["Exif.Image.ImageDescription"] = oss.str(); 
-                Exiv2::Image::UniquePtr image_exif_file = Exiv2::ImageFactory::open(filename.str());
-                image_exif_file->setExifData(exif_data);
-				image_exif_file->writeMetadata();
-                metadata_write_time_ = ros::Time::now().toSec() - t;
+            if (SAVE_ && SinkDecimator::takes(sinks, SinkDecimator::SINK_SAVE)) {
+                // a full disk or a broken file costs this image, not the writer thread
+                try {
+                    TraceScope trace("save", cam_no, frame_id);
+                    convertedImage->Save(filename.str().c_str());
+                    trace.end();
+                    ROS_DEBUG_STREAM("Image saved at " << filename.str());
+                    ml_save_time_ = ros::Time::now().toSec() - t;
+                    record_stage(times, STAGE_SAVE, ml_save_time_);
+                    t = ros::Time::now().toSec();
+
+                    boost::property_tree::ptree ptree;
+                    ptree.put("camera.block_name", trigger_message.block_name);
+                    ptree.put("camera.cam_no", cam_no);
+                    ptree.put("camera.image_number", trigger_message.image_number);
+                    ptree.put("camera.lat", trigger_message.lat);
+                    ptree.put("camera.lon", trigger_message.lon);
+                    ptree.put("camera.utm_x", trigger_message.utm_x);
+                    ptree.put("camera.utm_y", trigger_message.utm_y);
+                    ptree.put("camera.altitude", trigger_message.altitude);
+                    ptree.put("camera.heading", trigger_message.heading);
+                    ptree.put("camera.trigger_matched", trigger_matched);
+                    put_time_metadata(ptree, device_ns, stamp);
+                    put_chunk_metadata(ptree, chunk);
+                    TraceScope exif_trace("exif", cam_no, frame_id);
+                    write_exif_metadata(filename.str(), ptree);
+                    exif_trace.end();
+                    metadata_write_time_ = ros::Time::now().toSec() - t;
+                    record_stage(times, STAGE_METADATA, metadata_write_time_);
+                }
+                catch (const std::exception &e) {
+                    camera_states_[cam_no]->save_failures++;
+                    ROS_WARN_STREAM("Could not save image " << filename.str() << ": " << e.what());
+                    t = ros::Time::now().toSec();
+                }
             }
-            if (EXPORT_TO_ROS_){
+            if ((EXPORT_TO_ROS_ || PUBLISH_FRAME_SET_ || PUBLISH_COMPRESSED_) && SinkDecimator::takes(sinks, SinkDecimator::SINK_ROS)){
+                TraceScope trace("convert", cam_no, frame_id);
                 Mat mat_frame = convert_to_mat(convertedImage);
+                trace.end();
+                MemoryTokenPtr converted_memory = memory_.hold(cam_no, MEM_WRITING, image_bytes(mat_frame));
                 ml_toMat_time_ = ros::Time::now().toSec() - t;
+                record_stage(times, STAGE_CONVERT, ml_toMat_time_);
                 t = ros::Time::now().toSec();
                 std_msgs::Header img_msg_header;
                 string frame_id_prefix;
@@ -1274,42 +2388,47 @@ void acquisition::Capture::write_queue_to_disk(queue<Metadata>* img_q, int cam_n
                     frame_id_prefix = tf_prefix_ +"/";
                 else frame_id_prefix="";
 
+                TraceScope publish_trace("publish", cam_no, frame_id);
                 img_msg_header.frame_id = frame_id_prefix + "cam_"+to_string(cam_no)+"_optical_frame";
-                cam_info_msgs[cam_no]->header = img_msg_header;
-                img_msgs[cam_no]=cv_bridge::CvImage(img_msg_header, "bgr8", mat_frame).toImageMsg();
-                camera_image_pubs[cam_no].publish(img_msgs[cam_no],cam_info_msgs[cam_no]);
+                img_msg_header.stamp = stamp;
+                if (PUBLISH_FRAME_SET_)
+                    add_to_frame_set(set_index, set_size, cam_no, frame_id, mat_frame, img_msg_header);
+                if (PUBLISH_COMPRESSED_) {
+                    // the converted image is shared with the compressor, it counts as compressing from here on
+                    converted_memory.reset();
+                    converted_memory = memory_.hold(cam_no, MEM_COMPRESSING, image_bytes(mat_frame));
+                    compressed_pub_.enqueue(cam_no, mat_frame, "bgr8", img_msg_header, converted_memory);
+                }
+                if (CHUNK_DATA_)
+                    publish_frame_metadata(cam_no, chunk, img_msg_header);
+                if (EXPORT_TO_ROS_){
+                    cam_info_msgs[cam_no]->header = img_msg_header;
+                    img_msgs[cam_no]=cv_bridge::CvImage(img_msg_header, "bgr8", mat_frame).toImageMsg();
+                    camera_image_pubs[cam_no].publish(img_msgs[cam_no],cam_info_msgs[cam_no]);
                 
-                msgs_and_srvs::GpsTaggedImageMsg gps_tagged_image;
-                gps_tagged_image.image = *img_msgs[cam_no];
+                    msgs_and_srvs::GpsTaggedImageMsg gps_tagged_image;
+                    gps_tagged_image.image = *img_msgs[cam_no];
                 
-                gps_tagged_image.image_number = trigger_message.image_number;
-                gps_tagged_image.block_name = trigger_message.block_name;
-                gps_tagged_image.camera_number = cam_no;
-                gps_tagged_image.lat = trigger_message.lat;
-                gps_tagged_image.lon = trigger_message.lon;
-                gps_tagged_image.utm_x = trigger_message.utm_x;
-                gps_tagged_image.utm_y = trigger_message.utm_y;
-                gps_tagged_image.altitude = trigger_message.altitude;
-                gps_tagged_image.heading = trigger_message.heading;
-                camera_image_gps_pubs[cam_no].publish(gps_tagged_image);
-                ml_export_to_ROS_time_ = ros::Time::now().toSec() - t;
+                    gps_tagged_image.image_number = trigger_message.image_number;
+                    gps_tagged_image.block_name = trigger_message.block_name;
+                    gps_tagged_image.camera_number = cam_no;
+                    gps_tagged_image.lat = trigger_message.lat;
+                    gps_tagged_image.lon = trigger_message.lon;
+                    gps_tagged_image.utm_x = trigger_message.utm_x;
+                    gps_tagged_image.utm_y = trigger_message.utm_y;
+                    gps_tagged_image.altitude = trigger_message.altitude;
+                    gps_tagged_image.heading = trigger_message.heading;
+                    camera_image_gps_pubs[cam_no].publish(gps_tagged_image);
+                    ml_export_to_ROS_time_ = ros::Time::now().toSec() - t;
+                    record_stage(times, STAGE_EXPORT, ml_export_to_ROS_time_);
+                }
             }
 
             imageCnt++;
-            double total_time = ml_grab_time_ + ml_save_time_ + metadata_write_time_+ ml_toMat_time_+export_to_ROS_time_;
-            msgs_and_srvs::CollectionBenchmarkMsg benchmarkMsg;
-            benchmarkMsg.totalTime = total_time*1000;
-            benchmarkMsg.fps = 1/total_time;
-            benchmarkMsg.grab = ml_grab_time_*1000;
-            benchmarkMsg.save = ml_save_time_*1000;
-            benchmarkMsg.writeMetadata = metadata_write_time_*1000;
-            benchmarkMsg.convert = ml_toMat_time_*1000;
-            benchmarkMsg.export2Ros = ml_export_to_ROS_time_*1000;
-            benchmarkMsg.queueSize = (int)img_q->size();
-            benchmark_pubs[cam_no].publish(benchmarkMsg);
-            ROS_INFO_COND(TIME_BENCHMARK_,"total time (ms): %.1f \tFPS: %.1f",total_time*1000,1/total_time);
-            ROS_INFO_COND(TIME_BENCHMARK_,"Times (ms):- grab: %.1f, save: %.1f, metadata: %.1f, toMat: %.1f, exp2ROS: %.1f",
-                          ml_grab_time_*1000,ml_save_time_*1000,metadata_write_time_*1000,ml_toMat_time_*1000,ml_export_to_ROS_time_*1000);
+            double total_time = ml_grab_time_ + ml_save_time_ + metadata_write_time_+ ml_toMat_time_+ml_export_to_ROS_time_;
+            record_stage(times, STAGE_TOTAL, total_time);
+            times.frames.fetch_add(1, std::memory_order_relaxed);
+            times.queue_size.store((unsigned int)img_q->size(), std::memory_order_relaxed);
             ROS_DEBUG_STREAM("Image Queue size for cam"<< cam_no <<" is ="<< img_q->size());
             
             // release the image before popping out to save memory
@@ -1326,25 +2445,44 @@ void acquisition::Capture::write_queue_to_disk(queue<Metadata>* img_q, int cam_n
 
 void acquisition::Capture::acquire_images_to_queue(vector<queue<Metadata>>*  img_qs) {    
     ROS_DEBUG("  Acquire Images to Queue Thread Initiated");
+    trace_thread_name("acquisition");
+    boost::mutex::scoped_lock lock(acquisition_mutex_);
     start_acquisition();
+    lock.unlock();
     ROS_DEBUG("  Acquire Images to Queue Thread -> Acquisition Started");
     double t = ros::Time::now().toSec();
     double acquire_time = ros::Time::now().toSec();
+    uint64_t set_index = 0;
+    uint64_t sequence_gaps = 0;
     // Retrieve, convert, and save images for each camera
     try{
         while( ros::ok() ) {
+            TraceScope lock_trace("acquisition_lock");
+            yield_to_reconfiguration();
+            boost::mutex::scoped_lock round_lock(acquisition_mutex_);
+            lock_trace.end();
             for (int i = 0; i < numCameras_; i++) {
                 t = ros::Time::now().toSec();
+                if (!camera_online(i))
+                    continue;
+                if (camera_states_[i]->rejoined.exchange(false))
+                    queue_assembler_.rejoin(i);
                 try {
                     //  grab_frame() is a blocking call. It waits for the next image acquired by the camera 
                     struct Metadata captured_image;
+                    TraceScope trace("grab", i);
                     captured_image.image = cams[i].grab_frame();
-                    captured_image.trigger_message = *nmea_trigger;
-                    queue_mutex_.lock();
-                    img_qs->at(i).push(captured_image);
-                    queue_mutex_.unlock();
-                    ROS_DEBUG_STREAM("Queue no. "<<i<<" size: "<<img_qs->at(i).size());
-                    
+                    if (!captured_image.image.IsValid())
+                        continue;
+                    trace.set_frame_id(cams[i].get_frame_id());
+                    trace.end();
+                    captured_image.memory = memory_.hold(i, MEM_ASSEMBLING, captured_image.image->GetBufferSize());
+                    // taken from the camera, images of simulated cameras carry no timestamp or chunk data themselves
+                    captured_image.device_ns = cams[i].get_timestamp_ns();
+                    captured_image.frame_id = cams[i].get_frame_id();
+                    captured_image.chunk = cams[i].get_chunk_metadata();
+                    captured_image.stamp = host_time(i, captured_image.device_ns);
+                    queue_assembler_.add(i, captured_image.frame_id, captured_image.stamp.toNSec(), captured_image);
                 }
                 catch (Spinnaker::Exception &e) {
                     ROS_ERROR_STREAM("  Exception in Acquire to queue thread" << "\nError: " << e.what());
@@ -1356,6 +2494,61 @@ void acquisition::Capture::acquire_images_to_queue(vector<queue<Metadata>>*  img
                     camera_fps_pub.publish(camerafpsMsg);
                 }
             }
+
+            // hand the matched sets to the writers, all cameras of a set share one set index and output decision
+            FrameSet<Metadata> set;
+            TraceScope dispatch_trace("dispatch");
+            while (queue_assembler_.next(set)) {
+                double now = ros::Time::now().toSec();
+                unsigned int set_size = 0;
+                for (int i = 0; i < numCameras_; i++) {
+                    // a camera missing from the set has no frame to count towards its save_every/ros_every
+                    if (!set.present[i])
+                        continue;
+                    set.frames[i].sinks = decimator_.select(i, now);
+                    if (SinkDecimator::takes(set.frames[i].sinks, SinkDecimator::SINK_ROS))
+                        set_size++;
+                }
+                ROS_WARN_STREAM_COND(!set.complete, "Incomplete set of images for master frame ID " << set.frame_id << "!");
+
+                // all images of the set were taken at the same position
+                msgs_and_srvs::ImageTriggerMsg trigger_message;
+                bool trigger_matched = trigger_queue_.match(set.stamp_ns, trigger_message);
+                if (!trigger_matched && trigger_queue_.received() > 0)
+                    ROS_WARN_STREAM_THROTTLE(1.0, "No trigger message for master frame ID " << set.frame_id << ", "
+                                             << trigger_queue_.unmatched_frames() << " image set(s) and "
+                                             << trigger_queue_.unmatched_triggers() << " trigger message(s) unmatched so far");
+                if (trigger_queue_.sequence_gaps() > sequence_gaps) {
+                    sequence_gaps = trigger_queue_.sequence_gaps();
+                    ROS_WARN_STREAM("Image number " << trigger_message.image_number << " of the trigger message for master frame ID "
+                                    << set.frame_id << " does not follow the previous one");
+                }
+
+                queue_mutex_.lock();
+                for (int i = 0; i < numCameras_; i++) {
+                    if (!set.present[i])
+                        continue;
+                    set.frames[i].trigger_message = trigger_message;
+                    set.frames[i].trigger_matched = trigger_matched;
+                    set.frames[i].set_index = set_index;
+                    set.frames[i].set_size = set_size;
+                    set.frames[i].memory = memory_.hold(i, MEM_QUEUED, set.frames[i].image->GetBufferSize());
+                    img_qs->at(i).push(set.frames[i]);
+                    ROS_DEBUG_STREAM("Queue no. "<<i<<" size: "<<img_qs->at(i).size());
+                }
+                queue_mutex_.unlock();
+                set_index++;
+            }
+
+            // images that could not be matched to any set are released right away
+            vector<Metadata> dropped;
+            vector<int> dropped_cams;
+            queue_assembler_.take_dropped(dropped, dropped_cams);
+            count_dropped(dropped_cams);
+            for (int i = 0; i < dropped.size(); i++)
+                dropped[i].image->Release();
+            ROS_WARN_STREAM_COND(dropped.size(), "Dropped " << dropped.size() << " image(s) that matched no frame set, "
+                                 << queue_assembler_.resyncs() << " resync(s) so far");
         }
     }
     catch(const std::exception &e){
@@ -1400,6 +2593,226 @@ void acquisition::Capture::run() {
     ROS_DEBUG("Run completed");
 }
 
+void acquisition::Capture::trigger_master() {
+
+    // without the master nothing is triggered, the slaves time out until it is back
+    boost::mutex::scoped_lock lock(camera_states_[MASTER_CAM_]->device_mutex);
+    if (!camera_online(MASTER_CAM_)) {
+        lock.unlock();
+        ROS_WARN_STREAM_THROTTLE(5.0, "Master camera " << cams[MASTER_CAM_].get_id() << " is disconnected, no images are triggered");
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        return;
+    }
+    try {
+        cams[MASTER_CAM_].trigger();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_ERROR_STREAM_THROTTLE(1.0, "Triggering master camera " << cams[MASTER_CAM_].get_id() << " failed: " << e.what());
+    }
+
+}
+
+// Takes unplugged cameras out of the array and brings them back once they are connected again
+void acquisition::Capture::watch_cameras() {
+
+    ROS_DEBUG("  Hot-plug Watchdog Thread Initiated");
+    trace_thread_name("hot-plug watchdog");
+    try{
+        while( ros::ok() ) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(int(hotplug_interval_*1000)));
+
+            bool any_offline = false;
+            for (int i = 0; i < numCameras_; i++) {
+                CameraState& state = *camera_states_[i];
+                if (state.online && !cams[i].is_connected()) {
+                    // the acquisition thread may be grabbing from or triggering the camera right now
+                    pause_acquisition_++;
+                    boost::mutex::scoped_lock lock(acquisition_mutex_);
+                    boost::mutex::scoped_lock device_lock(state.device_mutex);
+                    state.online = false;
+                    state.lost_at = ros::WallTime::now();
+                    state.outages++;
+                    ROS_ERROR_STREAM("Camera " << cams[i].get_id() << " disconnected, recording goes on with the other cameras");
+                    cams[i].release_device();
+                    device_lock.unlock();
+                    lock.unlock();
+                    pause_acquisition_--;
+                }
+                any_offline = any_offline || !state.online;
+            }
+            if (!any_offline)
+                continue;
+
+            CameraList camList = system_->GetCameras();
+            for (int i = 0; i < numCameras_; i++) {
+                CameraState& state = *camera_states_[i];
+                if (state.online)
+                    continue;
+                CameraPtr pCam = camList.GetBySerial(cams[i].get_id());
+                if (!pCam.IsValid())
+                    continue;
+
+                ROS_INFO_STREAM("Camera " << cams[i].get_id() << " is back, reinitializing...");
+                pause_acquisition_++;
+                boost::mutex::scoped_lock lock(acquisition_mutex_);
+                boost::mutex::scoped_lock device_lock(state.device_mutex);
+                bool started = false;
+                cams[i].attach_device(pCam);
+                if (configure_camera(i, false)) {
+                    try {
+                        cams[i].begin_acquisition();
+                        started = true;
+                    }
+                    catch (Spinnaker::Exception &e) {
+                        ROS_ERROR_STREAM("Camera " << cams[i].get_id() << " could not start acquisition: " << e.what());
+                    }
+                }
+                if (!started) {
+                    cams[i].release_device();
+                    device_lock.unlock();
+                    lock.unlock();
+                    pause_acquisition_--;
+                    continue;
+                }
+
+                double outage = (ros::WallTime::now() - state.lost_at).toSec();
+                state.outage_secs += outage;
+                state.rejoined = true;
+                state.online = true;
+                device_lock.unlock();
+                lock.unlock();
+                pause_acquisition_--;
+                ROS_INFO("Camera %s rejoined after %.1f s offline (%u outage(s), %.1f s in total)",
+                         cams[i].get_id().c_str(), outage, state.outages, state.outage_secs);
+            }
+            camList.Clear();
+        }
+    }
+    catch (boost::thread_interrupted&) {
+        ROS_DEBUG("  Hot-plug Watchdog Thread Stopped");
+    }
+
+}
+
+void acquisition::Capture::sync_clocks() {
+
+    ROS_DEBUG("  Clock Sync Thread Initiated");
+    trace_thread_name("clock sync");
+    int round = 0;
+    try{
+        while( ros::ok() ) {
+            for (int i = 0; i < numCameras_; i++) {
+                int64_t device_ns, host_before_ns, host_after_ns;
+                boost::mutex::scoped_lock lock(camera_states_[i]->device_mutex);
+                if (!camera_online(i))
+                    continue;
+                try {
+                    if (cams[i].latch_timestamp(device_ns, host_before_ns, host_after_ns))
+                        clock_syncs_[i]->add_sample(device_ns, host_before_ns, host_after_ns);
+                    else
+                        ROS_WARN_STREAM_ONCE("Camera "<<cams[i].get_id()<<" has no TimestampLatch, its images are stamped on arrival");
+                }
+                catch (Spinnaker::Exception &e) {
+                    ROS_WARN_STREAM_THROTTLE(10, "Clock sync of camera "<<cams[i].get_id()<<" failed: "<<e.what());
+                }
+            }
+
+            round++;
+            if (round % 60 == 0) {
+                for (int i = 0; i < numCameras_; i++)
+                    ROS_DEBUG_STREAM("Camera "<<cams[i].get_id()<<" clock drift: "<<clock_syncs_[i]->drift_ppm()<<" ppm, "
+                                     <<clock_syncs_[i]->num_samples()<<" samples");
+            }
+
+            // a quick burst first so images are well stamped right from the start
+            boost::this_thread::sleep(boost::posix_time::milliseconds(round < 8 ? 50 : int(clock_sync_interval_*1000)));
+        }
+    }
+    catch (boost::thread_interrupted&) {
+        ROS_DEBUG("  Clock Sync Thread Stopped");
+    }
+
+}
+
+void acquisition::Capture::poll_stream_stats() {
+
+    ROS_DEBUG("  Stream Stats Thread Initiated");
+    trace_thread_name("stream stats");
+    try{
+        while( ros::ok() ) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(int(stream_stats_interval_*1000)));
+
+            for (int i = 0; i < numCameras_; i++) {
+                StreamCounters counters;
+                boost::mutex::scoped_lock device_lock(camera_states_[i]->device_mutex);
+                if (!camera_online(i))
+                    continue;
+                try {
+                    cams[i].read_stream_counters(counters);
+                }
+                catch (Spinnaker::Exception &e) {
+                    ROS_WARN_STREAM_THROTTLE(10, "Stream counters of camera "<<cams[i].get_id()<<" not readable: "<<e.what());
+                    continue;
+                }
+                device_lock.unlock();
+                boost::mutex::scoped_lock lock(stream_mutex_);
+                stream_counters_[i] = counters;
+            }
+        }
+    }
+    catch (boost::thread_interrupted&) {
+        ROS_DEBUG("  Stream Stats Thread Stopped");
+    }
+
+}
+
+// Host (ROS) time at which a camera captured an image with the given device timestamp
+ros::Time acquisition::Capture::host_time(int cam_no, int64_t device_ns) {
+
+    if (clock_sync_interval_ <= 0 || !clock_syncs_[cam_no]->valid())
+        return ros::Time::now();
+
+    ros::Time stamp;
+    stamp.fromNSec(clock_syncs_[cam_no]->to_host(device_ns));
+    return stamp;
+
+}
+
+void acquisition::Capture::put_time_metadata(boost::property_tree::ptree& ptree, int64_t device_ns, const ros::Time& stamp) {
+
+    ptree.put("camera.device_timestamp_ns", device_ns);
+    ptree.put("camera.stamp_ns", stamp.toNSec());
+
+}
+
+void acquisition::Capture::put_chunk_metadata(boost::property_tree::ptree& ptree, const ChunkMetadata& chunk) {
+
+    if (!chunk.valid)
+        return;
+    ptree.put("camera.exposure_time_us", chunk.exposure_time_us);
+    ptree.put("camera.gain_db", chunk.gain_db);
+    ptree.put("camera.chunk_timestamp_ns", chunk.device_timestamp_ns);
+    ptree.put("camera.chunk_frame_id", chunk.frame_id);
+    ptree.put("camera.line_status", chunk.line_status);
+
+}
+
+void acquisition::Capture::publish_frame_metadata(int cam_no, const ChunkMetadata& chunk, const std_msgs::Header& header) {
+
+    if (!chunk.valid)
+        return;
+    spinnaker_sdk_camera_driver::FrameMetadataPtr msg(new spinnaker_sdk_camera_driver::FrameMetadata());
+    msg->header = header;
+    msg->camera_name = cam_names_[cam_no];
+    msg->frame_id = chunk.frame_id;
+    msg->device_timestamp_ns = chunk.device_timestamp_ns;
+    msg->exposure_time = chunk.exposure_time_us;
+    msg->gain = chunk.gain_db;
+    msg->line_status = chunk.line_status;
+    frame_metadata_pubs_[cam_no].publish(msg);
+
+}
+
 std::string acquisition::Capture::todays_date()
 {
     char out[9];
@@ -1413,19 +2826,27 @@ std::string acquisition::Capture::todays_date()
 void acquisition::Capture::dynamicReconfigureCallback(spinnaker_sdk_camera_driver::spinnaker_camConfig &config, uint32_t level){
     
     ROS_INFO_STREAM("Dynamic Reconfigure: Level : " << level);
-    if(level == 1 || level ==3){
+    // the first call comes before the cameras are set up, it only takes over the parameters in use
+    if (level == ~0u) {
+        current_image_format(config);
+        config_ = config;
+        return;
+    }
+    if (level & 1){
         ROS_INFO_STREAM("Target grey value : " << config.target_grey_value);
         for (int i = numCameras_-1 ; i >=0 ; i--) {
-            
+            if (!camera_online(i))
+                continue;
             cams[i].setEnumValue("AutoExposureTargetGreyValueAuto", "Off");
             cams[i].setFloatValue("AutoExposureTargetGreyValue", config.target_grey_value);
         }
     }
-    if (level == 2 || level ==3){
+    if (level & 2){
         ROS_INFO_STREAM("Exposure "<<config.exposure_time);
         if(config.exposure_time > 0){
             for (int i = numCameras_-1 ; i >=0 ; i--) {
-
+                if (!camera_online(i))
+                    continue;
                 cams[i].setEnumValue("ExposureAuto", "Off");
                 cams[i].setEnumValue("ExposureMode", "Timed");
                 cams[i].setFloatValue("ExposureTime", config.exposure_time);
@@ -1433,20 +2854,241 @@ void acquisition::Capture::dynamicReconfigureCallback(spinnaker_sdk_camera_drive
         }
         else if(config.exposure_time ==0){
             for (int i = numCameras_-1 ; i >=0 ; i--) {
+                if (!camera_online(i))
+                    continue;
                 cams[i].setEnumValue("ExposureAuto", "Continuous");
                 cams[i].setEnumValue("ExposureMode", "Timed");
             }
         }
     }
+    if (level & 4){
+        // a format the cameras refused is reported back as the one still in use
+        if (!reconfigure_image_format(config))
+            current_image_format(config);
+    }
+    if (level & 8){
+        reconfigure_frame_rate(config.frame_rate);
+        config.frame_rate = frame_rate();
+    }
+    config_ = config;
+}
+
+// Writes the events recorded so far, tracing goes on
+bool acquisition::Capture::dumpTraceCallback(std_srvs::Trigger::Request&, std_srvs::Trigger::Response& res) {
+
+    if (!tracing_enabled()) {
+        res.success = false;
+        res.message = "Tracing is off, set trace_events to record a trace";
+        return true;
+    }
+    res.success = write_trace(trace_file_);
+    res.message = res.success ? trace_file_ : "Could not write " + trace_file_;
+    ROS_INFO_STREAM_COND(res.success, "Trace written to " << trace_file_);
+    return true;
+
+}
+
+bool acquisition::Capture::setImageFormatCallback(spinnaker_sdk_camera_driver::SetImageFormat::Request& req,
+                                                  spinnaker_sdk_camera_driver::SetImageFormat::Response& res){
+
+    // one change at a time, whether it comes from here or from dynamic reconfigure
+    boost::recursive_mutex::scoped_lock lock(config_mutex_);
+    spinnaker_sdk_camera_driver::spinnaker_camConfig config = config_;
+    uint32_t level = 0;
+    if (req.binning >= 0) { config.binning = req.binning; level |= 4; }
+    if (req.roi_width >= 0) { config.roi_width = req.roi_width; level |= 4; }
+    if (req.roi_height >= 0) { config.roi_height = req.roi_height; level |= 4; }
+    if (req.roi_x_offset >= 0) { config.roi_x_offset = req.roi_x_offset; level |= 4; }
+    if (req.roi_y_offset >= 0) { config.roi_y_offset = req.roi_y_offset; level |= 4; }
+    if (!req.pixel_format.empty()) {
+        if (req.pixel_format != "Mono8" && req.pixel_format != "BayerRG8") {
+            res.success = false;
+            res.message = "Unsupported pixel format " + req.pixel_format;
+            return true;
+        }
+        config.pixel_format = req.pixel_format == "BayerRG8" ? 1 : 0;
+        level |= 4;
+    }
+    if (req.frame_rate >= 0) { config.frame_rate = req.frame_rate; level |= 8; }
+
+    if (level == 0) {
+        res.success = true;
+        res.message = "Nothing to change";
+        return true;
+    }
+    spinnaker_sdk_camera_driver::spinnaker_camConfig requested = config;
+    dynamicReconfigureCallback(config, level);
+    // keeps the dynamic reconfigure clients in sync
+    dynamicReCfgServer_->updateConfig(config);
+
+    res.success = config.binning == requested.binning && config.roi_width == requested.roi_width &&
+                  config.roi_height == requested.roi_height && config.roi_x_offset == requested.roi_x_offset &&
+                  config.roi_y_offset == requested.roi_y_offset && config.pixel_format == requested.pixel_format;
+    res.message = res.success ? "Image format changed" : "Cameras refused the image format, see the log";
+    return true;
+}
+
+void acquisition::Capture::current_image_format(spinnaker_sdk_camera_driver::spinnaker_camConfig& config) {
+
+    // cameras with their own settings are represented by the master
+    const CameraSettings& settings = cam_settings_[MASTER_CAM_];
+    config.binning = settings.binning;
+    config.roi_width = settings.roi_width;
+    config.roi_height = settings.roi_height;
+    config.roi_x_offset = settings.roi_x_offset;
+    config.roi_y_offset = settings.roi_y_offset;
+    config.pixel_format = settings.color ? 1 : 0;
+    config.frame_rate = frame_rate();
+
+}
+
+// Changes binning, region of interest and pixel format of all cameras with acquisition stopped as briefly as possible
+bool acquisition::Capture::reconfigure_image_format(const spinnaker_sdk_camera_driver::spinnaker_camConfig& config) {
+
+    ROS_INFO("Changing image format: binning %d, region of interest %dx%d+%d+%d, %s",
+             config.binning, config.roi_width, config.roi_height, config.roi_x_offset, config.roi_y_offset,
+             config.pixel_format ? "BayerRG8" : "Mono8");
+
+    vector<CameraSettings> previous = cam_settings_;
+
+    // the acquisition threads finish their current round and wait until the cameras are restarted
+    pause_acquisition_++;
+    boost::mutex::scoped_lock lock(acquisition_mutex_);
+    ros::WallTime start = ros::WallTime::now();
+
+    // the new format applies to all cameras, including those that had their own
+    for (int i = 0; i < numCameras_; i++) {
+        CameraSettings& settings = cam_settings_[i];
+        settings.binning = config.binning;
+        settings.roi_width = config.roi_width;
+        settings.roi_height = config.roi_height;
+        settings.roi_x_offset = config.roi_x_offset;
+        settings.roi_y_offset = config.roi_y_offset;
+        settings.roi_set = config.roi_width || config.roi_height || config.roi_x_offset || config.roi_y_offset;
+        settings.color = config.pixel_format == 1;
+    }
+
+    // frames of the old format still waiting for their set are of no use anymore
+    vector<Metadata> dropped;
+    queue_assembler_.flush();
+    queue_assembler_.take_dropped(dropped);
+    for (int k = 0; k < dropped.size(); k++)
+        dropped[k].image->Release();
+    vector<GrabbedFrame> dropped_frames;
+    grab_assembler_.flush();
+    grab_assembler_.take_dropped(dropped_frames);
+
+    bool ok = true;
+    try {
+        end_acquisition();
+        for (int i = 0; i < numCameras_; i++) {
+            if (!camera_online(i))
+                continue;
+            try {
+                apply_image_format(i);
+            }
+            catch (Spinnaker::Exception &e) {
+                ROS_ERROR_STREAM("  Camera " << cams[i].get_id() << " refused the image format: " << e.what());
+                ok = false;
+                break;
+            }
+        }
+
+        if (!ok) {
+            cam_settings_ = previous;
+            for (int i = 0; i < numCameras_; i++)
+                if (camera_online(i))
+                    apply_image_format(i);
+        }
+
+        for (int i = 0; i < numCameras_; i++) {
+            if (!camera_online(i))
+                continue;
+            cams[i].set_color(cam_settings_[i].color);
+            // the image size changed, so did the memory the buffers need
+            configure_buffers(i);
+        }
+        plan_bandwidth();
+        start_acquisition();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_FATAL_STREAM("  Restarting acquisition failed: " << e.what());
+        ok = false;
+    }
+
+    update_camera_info();
+    GRID_CREATED_ = false;
+    pause_acquisition_--;
+
+    ROS_INFO("  Image format %s, acquisition paused for %.0f ms", ok ? "changed" : "left unchanged",
+             (ros::WallTime::now() - start).toSec()*1000);
+    return ok;
+}
+
+void acquisition::Capture::reconfigure_frame_rate(double fps) {
+
+    if (fps <= 0)
+        return;
+    // the rate is up to whoever triggers the cameras
+    if (EXTERNAL_TRIGGER_ || (MAX_RATE_SAVE_ && CODE_TRIGGER_)) {
+        ROS_WARN("Frame rate left unchanged, the cameras are triggered %s", EXTERNAL_TRIGGER_ ? "externally" : "by trigger messages");
+        return;
+    }
+    if (!MAX_RATE_SAVE_ && !SOFT_FRAME_RATE_CTRL_) {
+        ROS_WARN("Frame rate left unchanged, software rate control is off (soft_framerate)");
+        return;
+    }
+
+    // the master's rate and the bandwidth limits change between two rounds of grabbing
+    pause_acquisition_++;
+    boost::mutex::scoped_lock lock(acquisition_mutex_);
+    pause_acquisition_--;
+
+    if (MAX_RATE_SAVE_ && !CODE_TRIGGER_) {
+        // the free running master sets the pace, the slaves follow its trigger output
+        if (!camera_online(MASTER_CAM_))
+            return;
+        try {
+            cams[MASTER_CAM_].setBoolValue("AcquisitionFrameRateEnable", true);
+            cams[MASTER_CAM_].setFloatValue("AcquisitionFrameRate", fps);
+            master_fps_ = fps;
+            LIMIT_MASTER_RATE_ = true;
+        }
+        catch (Spinnaker::Exception &e) {
+            ROS_ERROR_STREAM("Could not set the frame rate of master camera " << cams[MASTER_CAM_].get_id() << ": " << e.what());
+            return;
+        }
+    } else {
+        soft_framerate_ = max(1, (int)round(fps));
+    }
+    ROS_INFO("Frame rate changed to %.1f fps", frame_rate());
+
+    try {
+        plan_bandwidth();
+    }
+    catch (Spinnaker::Exception &e) {
+        ROS_ERROR_STREAM("Could not update the bandwidth limits: " << e.what());
+    }
+}
+
+// Lets a pending reconfiguration or hot-plug change in before the next round of grabbing
+void acquisition::Capture::yield_to_reconfiguration() {
+
+    while (pause_acquisition_ > 0 && ros::ok())
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+
 }
 
 
 void acquisition::Capture::assignSoftwareTriggerCallback(const msgs_and_srvs::ImageTriggerMsg::ConstPtr& msg){
     
     ROS_DEBUG_STREAM("Callback");
-    nmea_trigger = *msg;
+    // only run_mt() matches the messages to image sets, the soft trigger loop merely takes the trigger
+    if (MAX_RATE_SAVE_ && !trigger_queue_.push(*msg, ros::Time::now().toNSec()))
+        ROS_WARN_STREAM_THROTTLE(1.0, "Trigger message buffer full, " << trigger_queue_.overflows() << " message(s) dropped so far");
     trigger_capture_ = true;
-    cams[MASTER_CAM_].trigger();
+    if (camera_online(MASTER_CAM_))
+        trigger_master();
 }
 
 
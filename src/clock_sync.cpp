@@ -0,0 +1,118 @@
+#include "spinnaker_sdk_camera_driver/clock_sync.h"
+#include <algorithm>
+#include <cmath>
+
+acquisition::ClockSync::ClockSync(int window) {
+
+    window_ = window > 2 ? window : 2;
+    device_ref_ = 0;
+    host_ref_ = 0;
+    slope_ = 1.0;
+    intercept_ = 0;
+    valid_ = false;
+
+}
+
+bool acquisition::ClockSync::add_sample(int64_t device_ns, int64_t host_before_ns, int64_t host_after_ns) {
+
+    Sample sample;
+    sample.device_ns = device_ns;
+    sample.host_ns = host_before_ns + (host_after_ns - host_before_ns)/2;
+    sample.round_trip_ns = host_after_ns - host_before_ns;
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // a device clock going backwards means the camera was power cycled, start over
+    if (!samples_.empty() && device_ns <= samples_.back().device_ns)
+        samples_.clear();
+
+    samples_.push_back(sample);
+    while (samples_.size() > window_)
+        samples_.pop_front();
+
+    fit();
+    return sample.round_trip_ns <= max_round_trip_ns();
+
+}
+
+int64_t acquisition::ClockSync::max_round_trip_ns() const {
+
+    // delay on the bus only ever adds to the round trip, so slow samples are the biased ones
+    int64_t min_round_trip = samples_.front().round_trip_ns;
+    for (deque<Sample>::const_iterator it = samples_.begin(); it != samples_.end(); it++)
+        min_round_trip = std::min(min_round_trip, it->round_trip_ns);
+    return 3*min_round_trip + 100000;
+
+}
+
+void acquisition::ClockSync::fit() {
+
+    device_ref_ = samples_.front().device_ns;
+    host_ref_ = samples_.front().host_ns;
+
+    int64_t max_round_trip = max_round_trip_ns();
+    double n = 0;
+    double x_mean = 0, y_mean = 0;
+    for (deque<Sample>::const_iterator it = samples_.begin(); it != samples_.end(); it++) {
+        if (it->round_trip_ns > max_round_trip)
+            continue;
+        n++;
+        x_mean += double(it->device_ns - device_ref_);
+        y_mean += double(it->host_ns - host_ref_);
+    }
+    x_mean /= n;
+    y_mean /= n;
+
+    double sxx = 0, sxy = 0;
+    for (deque<Sample>::const_iterator it = samples_.begin(); it != samples_.end(); it++) {
+        if (it->round_trip_ns > max_round_trip)
+            continue;
+        double dx = double(it->device_ns - device_ref_) - x_mean;
+        double dy = double(it->host_ns - host_ref_) - y_mean;
+        sxx += dx*dx;
+        sxy += dx*dy;
+    }
+
+    slope_ = 1.0;
+    // the drift of a crystal is a few ppm, anything far off is noise over a too short baseline
+    if (n >= 3 && sxx > 0 && std::fabs(sxy/sxx - 1.0) < 1e-3)
+        slope_ = sxy/sxx;
+    intercept_ = y_mean - slope_*x_mean;
+    valid_ = true;
+
+}
+
+bool acquisition::ClockSync::valid() const {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return valid_;
+
+}
+
+int64_t acquisition::ClockSync::to_host(int64_t device_ns) const {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return host_ref_ + (int64_t)llround(intercept_ + slope_*double(device_ns - device_ref_));
+
+}
+
+double acquisition::ClockSync::drift_ppm() const {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return (slope_ - 1.0)*1e6;
+
+}
+
+int64_t acquisition::ClockSync::offset_ns() const {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return host_ref_ + (int64_t)llround(intercept_) - device_ref_;
+
+}
+
+int acquisition::ClockSync::num_samples() const {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return samples_.size();
+
+}
@@ -0,0 +1,120 @@
+#include "spinnaker_sdk_camera_driver/compressed_publisher.h"
+
+acquisition::CompressedPublisher::~CompressedPublisher() {
+
+    shutdown();
+
+}
+
+acquisition::CompressedPublisher::CompressedPublisher() {
+
+    min_interval_ = 0;
+    running_ = false;
+
+}
+
+void acquisition::CompressedPublisher::init(ros::NodeHandle& nh, const vector<string>& cam_names, int num_threads,
+                                            string format, int quality, double max_rate) {
+
+    format_ = format;
+    if (format_.compare("png") == 0) {
+        encode_params_.push_back(IMWRITE_PNG_COMPRESSION);
+        encode_params_.push_back(quality);
+    } else {
+        format_ = "jpeg";
+        encode_params_.push_back(IMWRITE_JPEG_QUALITY);
+        encode_params_.push_back(quality);
+    }
+    min_interval_ = max_rate > 0 ? 1.0/max_rate : 0;
+
+    // image_transport style base topic, so the images can be viewed with _image_transport:=compressed
+    for (int i = 0; i < cam_names.size(); i++) {
+        compressed_pubs_.push_back(nh.advertise<sensor_msgs::CompressedImage>("camera_array/"+cam_names[i]+"/image_encoded/compressed", 1));
+        encode_time_pubs_.push_back(nh.advertise<std_msgs::Float64>("camera_array/"+cam_names[i]+"/encode_time", 1));
+        last_enqueued_.push_back(ros::Time(0));
+    }
+
+    running_ = true;
+    for (int i = 0; i < num_threads; i++)
+        workers_.create_thread(boost::bind(&CompressedPublisher::worker, this));
+
+    ROS_INFO_STREAM("  Compressed output: " << format_ << " quality " << quality << ", "
+                    << num_threads << " encoder threads, rate limit " << max_rate << " Hz");
+
+}
+
+void acquisition::CompressedPublisher::shutdown() {
+
+    if (!running_)
+        return;
+    running_ = false;
+    workers_.interrupt_all();
+    workers_.join_all();
+
+}
+
+bool acquisition::CompressedPublisher::enqueue(int cam_no, const Mat& frame, const string& encoding, const std_msgs::Header& header,
+                                               MemoryTokenPtr memory) {
+
+    ros::Time now = ros::Time::now();
+    if (min_interval_ > 0 && (now - last_enqueued_[cam_no]).toSec() < min_interval_)
+        return false;
+    last_enqueued_[cam_no] = now;
+
+    // Mat is reference counted, the frame is shared with the caller rather than copied
+    Job job;
+    job.cam_no = cam_no;
+    job.frame = frame;
+    job.encoding = encoding;
+    job.header = header;
+    job.memory = memory;
+
+    boost::mutex::scoped_lock lock(jobs_mutex_);
+    for (deque<Job>::iterator it = jobs_.begin(); it != jobs_.end(); it++) {
+        if (it->cam_no == cam_no) {
+            ROS_DEBUG_STREAM("Encoder busy, replacing pending frame of cam " << cam_no);
+            *it = job;
+            return true;
+        }
+    }
+    jobs_.push_back(job);
+    jobs_cond_.notify_one();
+    return true;
+
+}
+
+void acquisition::CompressedPublisher::worker() {
+
+    trace_thread_name("compressed publisher");
+    try {
+        while (true) {
+            Job job;
+            {
+                boost::mutex::scoped_lock lock(jobs_mutex_);
+                while (jobs_.empty())
+                    jobs_cond_.wait(lock);
+                job = jobs_.front();
+                jobs_.pop_front();
+            }
+
+            double t = ros::Time::now().toSec();
+            TraceScope trace("compress", job.cam_no);
+            sensor_msgs::CompressedImagePtr msg(new sensor_msgs::CompressedImage());
+            msg->header = job.header;
+            msg->format = job.encoding + "; " + format_ + " compressed " + job.encoding;
+            if (!imencode(format_.compare("png") == 0 ? ".png" : ".jpg", job.frame, msg->data, encode_params_)) {
+                ROS_WARN_STREAM("Failed to encode image of cam " << job.cam_no);
+                continue;
+            }
+            std_msgs::Float64 encode_time_msg;
+            encode_time_msg.data = (ros::Time::now().toSec() - t)*1000;
+
+            compressed_pubs_[job.cam_no].publish(msg);
+            encode_time_pubs_[job.cam_no].publish(encode_time_msg);
+        }
+    }
+    catch (boost::thread_interrupted&) {
+        ROS_DEBUG("Encoder thread stopped");
+    }
+
+}
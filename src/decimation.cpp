@@ -0,0 +1,54 @@
+#include "spinnaker_sdk_camera_driver/decimation.h"
+
+acquisition::SinkDecimator::SinkDecimator() {
+}
+
+void acquisition::SinkDecimator::init(int num_cams) {
+
+    SinkState pass_all;
+    pass_all.every = 1;
+    pass_all.min_interval = 0;
+    pass_all.since_last = 0;
+    pass_all.last_time = -1e9;
+    state_.assign(num_cams, vector<SinkState>(NUM_SINKS, pass_all));
+
+}
+
+void acquisition::SinkDecimator::set(Sink sink, int cam, int every, double max_rate) {
+
+    SinkState& s = state_[cam][sink];
+    s.every = every > 0 ? every : 1;
+    s.min_interval = max_rate > 0 ? 1.0/max_rate : 0;
+    // the first frame is always taken
+    s.since_last = s.every - 1;
+    s.last_time = -1e9;
+
+}
+
+unsigned int acquisition::SinkDecimator::select(int cam, double t) {
+
+    unsigned int mask = 0;
+    for (int sink = 0; sink < NUM_SINKS; sink++) {
+        SinkState& s = state_[cam][sink];
+        if (s.since_last + 1 >= s.every && (s.min_interval == 0 || t - s.last_time >= s.min_interval)) {
+            mask |= 1u << sink;
+            s.since_last = 0;
+            s.last_time = t;
+        } else {
+            s.since_last++;
+        }
+    }
+    return mask;
+
+}
+
+const char* acquisition::SinkDecimator::name(Sink sink) {
+
+    switch (sink) {
+        case SINK_SAVE: return "save";
+        case SINK_ROS: return "ros";
+        case SINK_PREVIEW: return "preview";
+        default: return "unknown";
+    }
+
+}
@@ -0,0 +1,36 @@
+#include "spinnaker_sdk_camera_driver/frame_output.h"
+#include <boost/property_tree/json_parser.hpp>
+#include <exiv2/exiv2.hpp>
+
+void acquisition::compose_grid(const vector<Mat>& frames, Mat& grid) {
+
+    // cameras may differ in size and pixel format, every tile takes the size of the first camera's image
+    int tile_width = grid.cols/frames.size();
+    for (int i=0; i<frames.size(); i++) {
+        if (frames[i].empty())
+            continue;
+        Mat tile = grid.colRange(i*tile_width, (i+1)*tile_width);
+        Mat frame = frames[i];
+        if (frame.channels() != grid.channels())
+            cvtColor(frame, frame, COLOR_GRAY2BGR);
+        if (frame.size() != tile.size())
+            resize(frame, tile, tile.size());
+        else
+            frame.copyTo(tile);
+    }
+
+}
+
+void acquisition::write_exif_metadata(const string& filename, const boost::property_tree::ptree& metadata) {
+
+    std::ostringstream oss;
+    boost::property_tree::write_json(oss, metadata);
+
+    Exiv2::ExifData exif_data;
+    exif_data["Exif.Image.Model"] = "Test 1";
+    exif_data["Exif.Image.ImageDescription"] = oss.str();
+    Exiv2::Image::UniquePtr image_exif_file = Exiv2::ImageFactory::open(filename);
+    image_exif_file->setExifData(exif_data);
+    image_exif_file->writeMetadata();
+
+}
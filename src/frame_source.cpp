@@ -0,0 +1,400 @@
+#include "spinnaker_sdk_camera_driver/frame_source.h"
+#include <boost/filesystem.hpp>
+
+acquisition::SimulatedTriggerLine::SimulatedTriggerLine(double rate, ros::WallTime epoch) {
+
+    epoch_ = epoch;
+    period_ns_ = rate > 0 ? int64_t(1e9 / rate) : 0;
+    last_tick_ns_ = 0;
+    drivers_ = 0;
+    count_ = 0;
+
+}
+
+int64_t acquisition::SimulatedTriggerLine::now_ns() {
+
+    return (ros::WallTime::now() - epoch_).toNSec();
+
+}
+
+void acquisition::SimulatedTriggerLine::set_rate(double rate) {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    period_ns_ = rate > 0 ? int64_t(1e9 / rate) : 0;
+
+}
+
+void acquisition::SimulatedTriggerLine::attach_driver() {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    drivers_++;
+
+}
+
+void acquisition::SimulatedTriggerLine::detach_driver() {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    drivers_--;
+
+}
+
+void acquisition::SimulatedTriggerLine::fire(int64_t time_ns) {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    times_ns_[count_ % HISTORY] = time_ns;
+    count_++;
+    cond_.notify_all();
+
+}
+
+uint64_t acquisition::SimulatedTriggerLine::count() {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    return count_;
+
+}
+
+bool acquisition::SimulatedTriggerLine::wait(uint64_t& seen, int64_t& time_ns, int64_t deadline_ns) {
+
+    boost::mutex::scoped_lock lock(mutex_);
+    while (count_ <= seen) {
+        int64_t now = now_ns();
+        int64_t wake = deadline_ns;
+        if (drivers_ == 0 && period_ns_ > 0) {
+            // ticks nobody waited for are delivered late like buffered frames, unless the line was idle for long
+            int64_t tick = last_tick_ns_ + period_ns_;
+            if (tick < now - period_ns_ * HISTORY)
+                tick = now / period_ns_ * period_ns_;
+            if (tick <= now) {
+                last_tick_ns_ = tick;
+                times_ns_[count_ % HISTORY] = tick;
+                count_++;
+                cond_.notify_all();
+                continue;
+            }
+            wake = min(wake, tick);
+        }
+        if (now >= deadline_ns)
+            return false;
+        cond_.timed_wait(lock, boost::posix_time::microseconds((wake - now) / 1000 + 1));
+    }
+
+    // a waiter that fell behind by more than the history lost the oldest triggers
+    if (count_ - seen > HISTORY)
+        seen = count_ - HISTORY;
+    time_ns = times_ns_[seen % HISTORY];
+    seen++;
+    return true;
+
+}
+
+acquisition::SyntheticSource::SyntheticSource(const string& id, std::shared_ptr<SimulatedTriggerLine> line,
+                                              int sensor_width, int sensor_height, double rate,
+                                              double jitter_ms, const string& drops)
+    : line_(line), own_line_(0, line->epoch()), random_(std::hash<string>()(id)) {
+
+    id_ = id;
+    sensor_width_ = sensor_width;
+    sensor_height_ = sensor_height;
+    format_ = PixelFormat_Mono8;
+    input_ = &own_line_;
+    software_trigger_ = false;
+    free_running_ = false;
+    strobe_ = false;
+    rate_ = rate > 0 ? rate : 30;
+    jitter_ns_ = int64_t(max(jitter_ms, 0.0) * 1e6);
+    drops_ = drops;
+    exposure_time_us_ = 0;
+    gain_db_ = 0;
+    initialized_ = false;
+    streaming_ = false;
+    seen_ = 0;
+    next_id_ = 0;
+    lost_frames_ = 0;
+
+}
+
+void acquisition::SyntheticSource::set_int(const string& feature, int64_t value) {
+
+    ints_[feature] = value;
+
+}
+
+void acquisition::SyntheticSource::set_float(const string& feature, double value) {
+
+    floats_[feature] = value;
+    if (feature == "ExposureTime")
+        exposure_time_us_ = value;
+    else if (feature == "Gain")
+        gain_db_ = value;
+    else if (feature == "AcquisitionFrameRate")
+        update_rate();
+
+}
+
+void acquisition::SyntheticSource::set_enum(const string& feature, const string& value) {
+
+    enums_[feature] = value;
+
+}
+
+void acquisition::SyntheticSource::set_bool(const string& feature, bool value) {
+
+    bools_[feature] = value;
+    if (feature == "AcquisitionFrameRateEnable")
+        update_rate();
+
+}
+
+int64_t acquisition::SyntheticSource::int_value(const string& feature, int64_t default_value) {
+
+    map<string, int64_t>::iterator it = ints_.find(feature);
+    return it != ints_.end() ? it->second : default_value;
+
+}
+
+string acquisition::SyntheticSource::enum_value(const string& feature, const string& default_value) {
+
+    map<string, string>::iterator it = enums_.find(feature);
+    return it != enums_.end() ? it->second : default_value;
+
+}
+
+int64_t acquisition::SyntheticSource::get_int_max(const string& feature) {
+
+    int64_t binning_x = max(int_value("BinningHorizontal", 1), (int64_t)1);
+    int64_t binning_y = max(int_value("BinningVertical", 1), (int64_t)1);
+    if (feature == "Width")
+        return sensor_width_ / binning_x - int_value("OffsetX", 0);
+    if (feature == "Height")
+        return sensor_height_ / binning_y - int_value("OffsetY", 0);
+    if (feature == "OffsetX")
+        return sensor_width_ / binning_x - int_value("Width", sensor_width_ / binning_x);
+    if (feature == "OffsetY")
+        return sensor_height_ / binning_y - int_value("Height", sensor_height_ / binning_y);
+    if (feature == "BinningHorizontal" || feature == "BinningVertical")
+        return 4;
+    return int_value(feature, 0);
+
+}
+
+double acquisition::SyntheticSource::get_float_max(const string& feature) {
+
+    if (feature == "Gain")
+        return 47.99;
+    if (feature == "ExposureTime")
+        return 30000000;
+    if (feature == "AcquisitionFrameRate")
+        return rate_;
+    map<string, double>::iterator it = floats_.find(feature);
+    return it != floats_.end() ? it->second : 0;
+
+}
+
+int64_t acquisition::SyntheticSource::payload_size() {
+
+    int64_t width = int_value("Width", get_int_max("Width"));
+    int64_t height = int_value("Height", get_int_max("Height"));
+    return width * height * (enum_value("PixelFormat", "Mono8") == "BGR8" ? 3 : 1);
+
+}
+
+// rate of a free running camera: the maximum rate, or the AcquisitionFrameRate if enabled and lower
+double acquisition::SyntheticSource::frame_rate() {
+
+    map<string, bool>::iterator enable = bools_.find("AcquisitionFrameRateEnable");
+    map<string, double>::iterator fps = floats_.find("AcquisitionFrameRate");
+    if (enable != bools_.end() && enable->second && fps != floats_.end() && fps->second > 0)
+        return min(rate_, fps->second);
+    return rate_;
+
+}
+
+void acquisition::SyntheticSource::update_rate() {
+
+    if (streaming_ && free_running_)
+        input_->set_rate(frame_rate());
+
+}
+
+void acquisition::SyntheticSource::begin_acquisition() {
+
+    string pixel_format = enum_value("PixelFormat", "Mono8");
+    PixelFormatEnums format = PixelFormat_Mono8;
+    if (pixel_format == "BayerRG8")
+        format = PixelFormat_BayerRG8;
+    else if (pixel_format == "BGR8")
+        format = PixelFormat_BGR8;
+    prepare_frames((int)int_value("Width", get_int_max("Width")), (int)int_value("Height", get_int_max("Height")), format);
+
+    // wired like the real array: the master's line 2 is an output, the slaves are triggered on line 3
+    bool triggered = enum_value("TriggerMode", "Off") == "On";
+    software_trigger_ = triggered && enum_value("TriggerSource", "Software") == "Software";
+    free_running_ = !triggered;
+    strobe_ = enum_value("LineMode", "Input") == "Output";
+    if ((triggered && !software_trigger_) || (free_running_ && strobe_))
+        input_ = line_.get();
+    else
+        input_ = &own_line_;
+    own_line_.set_rate(0);
+    if (free_running_)
+        input_->set_rate(frame_rate());
+    // the line follows the software triggers of the master instead of its own rate
+    if (software_trigger_ && strobe_)
+        line_->attach_driver();
+
+    seen_ = input_->count();
+    next_id_ = 0;
+    lost_frames_ = 0;
+    streaming_ = true;
+
+}
+
+void acquisition::SyntheticSource::end_acquisition() {
+
+    if (!streaming_)
+        return;
+    streaming_ = false;
+    if (software_trigger_ && strobe_)
+        line_->detach_driver();
+
+}
+
+void acquisition::SyntheticSource::trigger() {
+
+    if (!streaming_ || !software_trigger_)
+        return;
+    int64_t now = line_->now_ns();
+    own_line_.fire(now);
+    if (strobe_)
+        line_->fire(now);
+
+}
+
+bool acquisition::SyntheticSource::next_frame(SourceFrame& frame, uint64_t timeout_ms) {
+
+    if (frames_.empty())
+        return false;
+
+    int64_t deadline = line_->now_ns() + (int64_t)min(timeout_ms, (uint64_t)(INT64_MAX / 2000000)) * 1000000;
+    std::uniform_real_distribution<double> jitter(0, 1);
+    while (streaming_) {
+        // waits in short slices, so end_acquisition() isn't held up by an infinite timeout
+        int64_t trigger_ns;
+        if (!input_->wait(seen_, trigger_ns, min(deadline, line_->now_ns() + 100000000))) {
+            if (line_->now_ns() >= deadline)
+                return false;
+            continue;
+        }
+
+        int64_t frame_id = next_id_++;
+        if (!drops_.empty() && drops_[frame_id % drops_.size()] == '0') {
+            lost_frames_++;
+            continue;
+        }
+
+        int64_t stamp = trigger_ns + (jitter_ns_ > 0 ? int64_t(jitter(random_) * jitter_ns_) : 0);
+        int64_t delay = stamp - line_->now_ns();
+        if (delay > 0)
+            boost::this_thread::sleep(boost::posix_time::microseconds(delay / 1000));
+
+        frame.image = frames_[frame_id % frames_.size()];
+        frame.format = format_;
+        frame.timestamp_ns = stamp;
+        frame.frame_id = frame_id;
+        frame.exposure_time_us = exposure_time_us_;
+        frame.gain_db = gain_db_;
+        return true;
+    }
+    return false;
+
+}
+
+// the dropped frames are lost on the way, the host side never runs out of buffers
+int64_t acquisition::SyntheticSource::stream_counter(const string& name) {
+
+    if (name == "StreamLostFrameCount")
+        return lost_frames_;
+    if (name == "StreamDroppedFrameCount" || name == "StreamFailedBufferCount" || name == "StreamBufferUnderrunCount")
+        return 0;
+    return -1;
+
+}
+
+void acquisition::SyntheticSource::prepare_frames(int width, int height, PixelFormatEnums format) {
+
+    width = max(width, 1);
+    height = max(height, 1);
+    if (!frames_.empty() && frames_[0].cols == width && frames_[0].rows == height && format_ == format)
+        return;
+
+    // a few shifted gradients, so consecutive images differ like a moving scene
+    format_ = format;
+    frames_.clear();
+    for (int k = 0; k < 8; k++) {
+        Mat frame(height, width, CV_8UC1);
+        for (int y = 0; y < height; y++) {
+            uchar* row = frame.ptr<uchar>(y);
+            for (int x = 0; x < width; x++) {
+                // RGGB mosaic of a horizontal red, vertical green and moving diagonal blue gradient
+                if (format == PixelFormat_BayerRG8 && y % 2 == 0 && x % 2 == 0)
+                    row[x] = x * 255 / width;
+                else if (format == PixelFormat_BayerRG8 && y % 2 != x % 2)
+                    row[x] = y * 255 / height;
+                else
+                    row[x] = (x + y + k * 32) & 255;
+            }
+        }
+        frames_.push_back(frame);
+    }
+    ROS_DEBUG_STREAM("Synthetic camera " << id_ << ": " << width << "x" << height << " test images generated");
+
+}
+
+acquisition::ReplaySource::ReplaySource(const string& id, const string& path, std::shared_ptr<SimulatedTriggerLine> line,
+                                        double rate, double jitter_ms, const string& drops)
+    : SyntheticSource(id, line, 0, 0, rate, jitter_ms, drops) {
+
+    vector<string> files;
+    if (boost::filesystem::is_directory(path)) {
+        boost::filesystem::directory_iterator end;
+        for (boost::filesystem::directory_iterator it(path); it != end; ++it)
+            if (boost::filesystem::is_regular_file(it->status()))
+                files.push_back(it->path().string());
+    }
+    // saved file names carry a zero padded image count, so name order is recording order
+    sort(files.begin(), files.end());
+
+    // decoded up front, so replay timing doesn't depend on the disk
+    double bytes = 0;
+    for (int i = 0; i < files.size(); i++) {
+        Mat image = imread(files[i], IMREAD_UNCHANGED);
+        if (image.empty() || image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+            ROS_DEBUG_STREAM("Replay " << id << ": skipping " << files[i]);
+            continue;
+        }
+        if (!frames_.empty() && (image.size() != frames_[0].size() || image.type() != frames_[0].type())) {
+            ROS_WARN_STREAM("Replay " << id << ": " << files[i] << " differs in size or type from the first image, skipped");
+            continue;
+        }
+        frames_.push_back(image);
+        bytes += image.total() * image.elemSize();
+    }
+
+    if (frames_.empty()) {
+        ROS_ERROR_STREAM("Replay " << id << ": no images found in " << path);
+        return;
+    }
+    sensor_width_ = frames_[0].cols;
+    sensor_height_ = frames_[0].rows;
+    format_ = frames_[0].channels() == 3 ? PixelFormat_BGR8 : PixelFormat_Mono8;
+    ROS_INFO("  Replay %s: %d images of %dx%d from %s (%.0f MB)", id.c_str(), (int)frames_.size(),
+             sensor_width_, sensor_height_, path.c_str(), bytes / 1048576);
+
+}
+
+int64_t acquisition::ReplaySource::payload_size() {
+
+    return frames_.empty() ? 0 : frames_[0].total() * frames_[0].elemSize();
+
+}
@@ -0,0 +1,57 @@
+#include "spinnaker_sdk_camera_driver/memory_account.h"
+
+acquisition::MemoryToken::MemoryToken(MemoryAccount* account, int cam, int stage, int64_t bytes)
+    : account_(account), cam_(cam), stage_(stage), bytes_(bytes) {
+
+    account_->add(cam_, stage_, bytes_);
+
+}
+
+acquisition::MemoryToken::~MemoryToken() {
+
+    account_->add(cam_, stage_, -bytes_);
+
+}
+
+void acquisition::MemoryAccount::init(int num_cams, int num_stages) {
+
+    num_cams_ = num_cams;
+    num_stages_ = num_stages;
+    int num_cells = (num_cams + 1) * (num_stages + 1);
+    cells_.reset(new Cell[num_cells]);
+    for (int k = 0; k < num_cells; k++) {
+        cells_[k].bytes = 0;
+        cells_[k].peak = 0;
+        cells_[k].max = 0;
+    }
+
+}
+
+int64_t acquisition::MemoryAccount::take_peak(int cam, int stage) {
+
+    Cell& c = cell(cam, stage);
+    return c.peak.exchange(c.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+}
+
+// the image counts for its stage, the total of its camera and the total of all cameras
+void acquisition::MemoryAccount::add(int cam, int stage, int64_t bytes) {
+
+    add_to_cell(cell(cam, stage), bytes);
+    add_to_cell(cell(cam, num_stages_), bytes);
+    add_to_cell(cell(num_cams_, stage), bytes);
+    add_to_cell(cell(num_cams_, num_stages_), bytes);
+
+}
+
+void acquisition::MemoryAccount::add_to_cell(Cell& cell, int64_t bytes) {
+
+    int64_t now = cell.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes <= 0)
+        return;
+    int64_t peak = cell.peak.load(std::memory_order_relaxed);
+    while (now > peak && !cell.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    int64_t max = cell.max.load(std::memory_order_relaxed);
+    while (now > max && !cell.max.compare_exchange_weak(max, now, std::memory_order_relaxed)) {}
+
+}
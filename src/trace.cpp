@@ -0,0 +1,124 @@
+#include "spinnaker_sdk_camera_driver/trace.h"
+#include <boost/thread.hpp>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+std::atomic<bool> acquisition::tracing_on(false);
+
+namespace {
+
+    struct TraceEvent {
+        const char* name;
+        int cam;
+        int64_t frame_id;
+        int64_t begin_ns;
+        int64_t end_ns;
+    };
+
+    // the locks are only ever contended while the trace is written
+    struct ThreadBuffer {
+        int tid;
+        string name;
+        vector<TraceEvent> events;
+        uint64_t count;
+        boost::mutex mutex;
+    };
+
+    boost::mutex registry_mutex;
+    vector< std::shared_ptr<ThreadBuffer> > registry;
+    size_t events_per_thread = 0;
+    thread_local ThreadBuffer* thread_buffer = NULL;
+
+    ThreadBuffer* own_buffer() {
+
+        if (!thread_buffer) {
+            boost::mutex::scoped_lock lock(registry_mutex);
+            std::shared_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+            buffer->tid = registry.size() + 1;
+            buffer->name = "thread " + to_string(buffer->tid);
+            buffer->events.resize(max(events_per_thread, (size_t)1));
+            buffer->count = 0;
+            registry.push_back(buffer);
+            thread_buffer = buffer.get();
+        }
+        return thread_buffer;
+
+    }
+
+}
+
+void acquisition::enable_tracing(size_t events) {
+
+    {
+        boost::mutex::scoped_lock lock(registry_mutex);
+        events_per_thread = events;
+    }
+    tracing_on = events > 0;
+
+}
+
+void acquisition::disable_tracing() {
+
+    tracing_on = false;
+
+}
+
+void acquisition::trace_thread_name(const string& name) {
+
+    ThreadBuffer* buffer = own_buffer();
+    boost::mutex::scoped_lock lock(buffer->mutex);
+    buffer->name = name;
+
+}
+
+void acquisition::trace_event(const char* name, int cam, int64_t frame_id, int64_t begin_ns, int64_t end_ns) {
+
+    if (!tracing_enabled())
+        return;
+    ThreadBuffer* buffer = own_buffer();
+    boost::mutex::scoped_lock lock(buffer->mutex);
+    TraceEvent& event = buffer->events[buffer->count % buffer->events.size()];
+    event.name = name;
+    event.cam = cam;
+    event.frame_id = frame_id;
+    event.begin_ns = begin_ns;
+    event.end_ns = end_ns;
+    buffer->count++;
+
+}
+
+bool acquisition::write_trace(const string& filename) {
+
+    std::ofstream out(filename.c_str());
+    if (!out)
+        return false;
+
+    // complete ("X") events in us, each thread with its name and the events in the order they ended
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    boost::mutex::scoped_lock registry_lock(registry_mutex);
+    for (size_t b = 0; b < registry.size(); b++) {
+        ThreadBuffer& buffer = *registry[b];
+        boost::mutex::scoped_lock lock(buffer.mutex);
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.tid
+            << ", \"args\": {\"name\": \"" << buffer.name << "\"}}";
+        first = false;
+
+        uint64_t size = buffer.events.size();
+        uint64_t start = buffer.count > size ? buffer.count - size : 0;
+        for (uint64_t k = start; k < buffer.count; k++) {
+            const TraceEvent& event = buffer.events[k % size];
+            char line[256];
+            snprintf(line, sizeof(line), ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                     "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"cam\": %d, \"frame_id\": %lld}}",
+                     event.name, event.cam < 0 ? "array" : "camera", buffer.tid, event.begin_ns / 1e3,
+                     (event.end_ns - event.begin_ns) / 1e3, event.cam, (long long)event.frame_id);
+            out << line;
+        }
+    }
+    out << "\n]}\n";
+    out.close();
+    return !out.fail();
+
+}
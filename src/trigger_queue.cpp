@@ -0,0 +1,92 @@
+#include "spinnaker_sdk_camera_driver/trigger_queue.h"
+#include <cstdlib>
+
+acquisition::TriggerQueue::TriggerQueue(size_t capacity) {
+
+    ring_.resize(capacity > 0 ? capacity : 1);
+    head_ = 0;
+    tail_ = 0;
+    window_ns_ = 50000000;
+    have_last_ = false;
+    last_image_number_ = 0;
+    received_ = 0;
+    matched_ = 0;
+    unmatched_frames_ = 0;
+    unmatched_triggers_ = 0;
+    sequence_gaps_ = 0;
+    overflows_ = 0;
+
+}
+
+bool acquisition::TriggerQueue::push(const msgs_and_srvs::ImageTriggerMsg& msg, int64_t receive_ns) {
+
+    received_.fetch_add(1, memory_order_relaxed);
+    size_t head = head_.load(memory_order_relaxed);
+    if (head - tail_.load(memory_order_acquire) >= ring_.size()) {
+        overflows_.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    Entry& entry = ring_[head % ring_.size()];
+    entry.msg = msg;
+    entry.receive_ns = receive_ns;
+    // publishes the entry to the consumer
+    head_.store(head + 1, memory_order_release);
+    return true;
+
+}
+
+void acquisition::TriggerQueue::pop() {
+
+    tail_.store(tail_.load(memory_order_relaxed) + 1, memory_order_release);
+
+}
+
+bool acquisition::TriggerQueue::match(int64_t frame_ns, msgs_and_srvs::ImageTriggerMsg& msg) {
+
+    size_t tail = tail_.load(memory_order_relaxed);
+    size_t head = head_.load(memory_order_acquire);
+
+    // messages too old for this frame can't belong to any later frame either
+    while (tail != head && ring_[tail % ring_.size()].receive_ns < frame_ns - window_ns_) {
+        pop();
+        tail++;
+        unmatched_triggers_.fetch_add(1, memory_order_relaxed);
+    }
+
+    // the closest message within the window wins, the ones before it were never matched
+    size_t best = head;
+    int64_t best_dt = 0;
+    for (size_t i = tail; i != head; i++) {
+        const Entry& entry = ring_[i % ring_.size()];
+        if (entry.receive_ns > frame_ns + window_ns_)
+            break;
+        int64_t dt = llabs(entry.receive_ns - frame_ns);
+        if (best == head || dt < best_dt) {
+            best = i;
+            best_dt = dt;
+        }
+    }
+
+    if (best == head) {
+        unmatched_frames_.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    for (; tail != best; tail++) {
+        pop();
+        unmatched_triggers_.fetch_add(1, memory_order_relaxed);
+    }
+    msg = ring_[best % ring_.size()].msg;
+    pop();
+
+    int64_t image_number = (int64_t)msg.image_number;
+    if (have_last_ && image_number != last_image_number_ + 1)
+        sequence_gaps_.fetch_add(1, memory_order_relaxed);
+    have_last_ = true;
+    last_image_number_ = image_number;
+
+    matched_.fetch_add(1, memory_order_relaxed);
+    return true;
+
+}
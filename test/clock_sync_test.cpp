@@ -0,0 +1,130 @@
+#include "spinnaker_sdk_camera_driver/clock_sync.h"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace acquisition;
+
+namespace {
+
+    const int64_t DEVICE_START_NS = 5000000000LL;           // camera powered on 5 s ago
+    const int64_t HOST_START_NS = 1600000000000000000LL;    // host time of DEVICE_START_NS
+    const int64_t INTERVAL_NS = 1000000000LL;               // clock_sync_interval of 1 s
+
+    // a camera whose clock runs drift_ppm fast relative to the host
+    struct SyntheticCamera {
+
+        SyntheticCamera(double drift_ppm) : drift_ppm(drift_ppm), rng(42) {}
+
+        int64_t host_ns(int64_t device_ns) const {
+            int64_t elapsed = device_ns - DEVICE_START_NS;
+            return HOST_START_NS + elapsed + (int64_t)llround(elapsed * drift_ppm * 1e-6);
+        }
+
+        // latches the device clock with a round trip of round_trip_ns around it, of which extra_delay_ns only after it
+        bool sample(ClockSync& sync, int64_t device_ns, int64_t round_trip_ns, int64_t jitter_ns, int64_t extra_delay_ns = 0) {
+            std::uniform_int_distribution<int64_t> jitter(-jitter_ns, jitter_ns);
+            int64_t latched = host_ns(device_ns) + jitter(rng);
+            return sync.add_sample(device_ns, latched - round_trip_ns/2, latched + round_trip_ns/2 + extra_delay_ns);
+        }
+
+        double drift_ppm;
+        std::mt19937_64 rng;
+
+    };
+
+}
+
+TEST(ClockSync, InvalidWithoutSamples) {
+
+    ClockSync sync;
+    EXPECT_FALSE(sync.valid());
+    EXPECT_EQ(0, sync.num_samples());
+
+}
+
+TEST(ClockSync, RecoversOffsetAndDriftWithoutJitter) {
+
+    ClockSync sync;
+    SyntheticCamera cam(20.0);
+    for (int k = 0; k < 32; k++)
+        EXPECT_TRUE(cam.sample(sync, DEVICE_START_NS + k*INTERVAL_NS, 200000, 0));
+
+    ASSERT_TRUE(sync.valid());
+    EXPECT_NEAR(20.0, sync.drift_ppm(), 0.01);
+    int64_t device_ns = DEVICE_START_NS + 10*INTERVAL_NS + 123456789;
+    EXPECT_NEAR(cam.host_ns(device_ns), sync.to_host(device_ns), 10);
+
+}
+
+TEST(ClockSync, AveragesOutJitter) {
+
+    ClockSync sync;
+    SyntheticCamera cam(-35.0);
+    for (int k = 0; k < 100; k++)
+        cam.sample(sync, DEVICE_START_NS + k*INTERVAL_NS, 200000, 20000);
+
+    EXPECT_EQ(32, sync.num_samples());
+    EXPECT_NEAR(-35.0, sync.drift_ppm(), 1.0);
+    // within the window and one interval past the last sample, as for images between two samples
+    for (int64_t device_ns = DEVICE_START_NS + 70*INTERVAL_NS; device_ns <= DEVICE_START_NS + 100*INTERVAL_NS;
+         device_ns += INTERVAL_NS/3)
+        EXPECT_NEAR(cam.host_ns(device_ns), sync.to_host(device_ns), 20000);
+
+}
+
+TEST(ClockSync, LeavesOutSlowRoundTrips) {
+
+    ClockSync sync;
+    SyntheticCamera cam(10.0);
+    for (int k = 0; k < 64; k++) {
+        // every fourth latch is held up on the bus after the fact, its midpoint is 2 ms late
+        bool delayed = k % 4 == 3;
+        bool used = cam.sample(sync, DEVICE_START_NS + k*INTERVAL_NS, 200000, 5000, delayed ? 4000000 : 0);
+        EXPECT_EQ(!delayed, used) << "sample " << k;
+    }
+
+    EXPECT_NEAR(10.0, sync.drift_ppm(), 1.0);
+    int64_t device_ns = DEVICE_START_NS + 60*INTERVAL_NS + INTERVAL_NS/2;
+    EXPECT_NEAR(cam.host_ns(device_ns), sync.to_host(device_ns), 10000);
+
+}
+
+TEST(ClockSync, IgnoresImplausibleDrift) {
+
+    // a slope 1% off is no crystal drift, the offset is kept and the drift assumed 0
+    ClockSync sync;
+    SyntheticCamera cam(10000.0);
+    for (int k = 0; k < 8; k++)
+        cam.sample(sync, DEVICE_START_NS + k*INTERVAL_NS, 200000, 0);
+
+    ASSERT_TRUE(sync.valid());
+    EXPECT_EQ(0.0, sync.drift_ppm());
+
+}
+
+TEST(ClockSync, StartsOverWhenDeviceClockGoesBack) {
+
+    ClockSync sync;
+    SyntheticCamera cam(15.0);
+    for (int k = 0; k < 16; k++)
+        cam.sample(sync, DEVICE_START_NS + k*INTERVAL_NS, 200000, 0);
+    ASSERT_EQ(16, sync.num_samples());
+
+    // power cycled: the device clock restarts near 0 while host time goes on
+    int64_t host_now = cam.host_ns(DEVICE_START_NS + 20*INTERVAL_NS);
+    int64_t device_now = 2000000000LL;
+    EXPECT_TRUE(sync.add_sample(device_now, host_now - 100000, host_now + 100000));
+    EXPECT_EQ(1, sync.num_samples());
+    EXPECT_EQ(0.0, sync.drift_ppm());
+    EXPECT_EQ(host_now + INTERVAL_NS, sync.to_host(device_now + INTERVAL_NS));
+    EXPECT_EQ(host_now - device_now, sync.offset_ns());
+
+}
+
+int main(int argc, char **argv) {
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+
+}
@@ -0,0 +1,235 @@
+#include "spinnaker_sdk_camera_driver/frame_set_assembler.h"
+#include <gtest/gtest.h>
+
+using namespace acquisition;
+
+namespace {
+
+    const int64_t PERIOD_NS = 100000000;        // 10 fps
+    const int64_t TOLERANCE_NS = 25000000;      // a quarter of the period, as the driver's default
+
+    // a frame is its camera and frame ID, so where it ended up can be checked
+    int frame(int cam, int64_t frame_id) { return cam*1000 + (int)frame_id; }
+
+    vector< FrameSet<int> > drain(FrameSetAssembler<int>& assembler) {
+        vector< FrameSet<int> > sets;
+        FrameSet<int> set;
+        while (assembler.next(set))
+            sets.push_back(set);
+        return sets;
+    }
+
+    // adds the frame of each camera of one trigger, a frame ID < 0 means the camera missed it
+    vector< FrameSet<int> > trigger(FrameSetAssembler<int>& assembler, const vector<int64_t>& frame_ids, int64_t stamp_ns,
+                                    const vector<int64_t>& jitter_ns = vector<int64_t>()) {
+        for (size_t c = 0; c < frame_ids.size(); c++)
+            if (frame_ids[c] >= 0)
+                assembler.add(c, frame_ids[c], stamp_ns + (jitter_ns.empty() ? 0 : jitter_ns[c]), frame(c, frame_ids[c]));
+        return drain(assembler);
+    }
+
+    void expect_dropped(FrameSetAssembler<int>& assembler, const vector<int>& expected_frames) {
+        vector<int> frames, cams;
+        assembler.take_dropped(frames, cams);
+        ASSERT_EQ(frames.size(), cams.size());
+        EXPECT_EQ(expected_frames, frames);
+        for (size_t k = 0; k < frames.size(); k++)
+            EXPECT_EQ(frames[k] / 1000, cams[k]) << "camera of dropped frame " << frames[k];
+    }
+
+}
+
+TEST(FrameSetAssembler, MatchesJitteredTimestamps) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(3, 0, TOLERANCE_NS, 2, false);
+    // the cameras count from different frame IDs and see the trigger a few ms apart
+    for (int k = 0; k < 10; k++) {
+        vector< FrameSet<int> > sets = trigger(assembler, {k, 100 + k, 500 + k}, k*PERIOD_NS,
+                                               {0, (k % 2 ? 1 : -1)*3000000, (k % 3 - 1)*5000000});
+        ASSERT_EQ(1u, sets.size());
+        EXPECT_TRUE(sets[0].complete);
+        EXPECT_EQ(k, sets[0].frame_id);
+        EXPECT_EQ(frame(1, 100 + k), sets[0].frames[1]);
+        EXPECT_EQ(frame(2, 500 + k), sets[0].frames[2]);
+    }
+    EXPECT_EQ(10u, assembler.complete_sets());
+    EXPECT_EQ(0u, assembler.dropped_frames());
+    // the offsets of both slaves were learned once
+    EXPECT_EQ(2u, assembler.resyncs());
+
+}
+
+TEST(FrameSetAssembler, MissedTriggerByFrameId) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, 0, 4, true);
+    trigger(assembler, {0, 0}, 0);
+    trigger(assembler, {1, 1}, PERIOD_NS);
+    // the slave's frame 2 is lost, its frame counter goes on
+    EXPECT_TRUE(trigger(assembler, {2, -1}, 2*PERIOD_NS).empty());
+    vector< FrameSet<int> > sets = trigger(assembler, {3, 3}, 3*PERIOD_NS);
+
+    // the set of frame 2 is given up as soon as the slave delivered a later frame, the next one is complete again
+    ASSERT_EQ(2u, sets.size());
+    EXPECT_EQ(2, sets[0].frame_id);
+    EXPECT_FALSE(sets[0].complete);
+    EXPECT_TRUE(sets[0].present[0]);
+    EXPECT_FALSE(sets[0].present[1]);
+    EXPECT_EQ(3, sets[1].frame_id);
+    EXPECT_TRUE(sets[1].complete);
+    EXPECT_EQ(frame(1, 3), sets[1].frames[1]);
+    EXPECT_EQ(3u, assembler.complete_sets());
+    EXPECT_EQ(1u, assembler.partial_sets());
+
+}
+
+TEST(FrameSetAssembler, MissedTriggerByFrameIdWithoutPartialSets) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, 0, 4, false);
+    trigger(assembler, {0, 0}, 0);
+    trigger(assembler, {1, -1}, PERIOD_NS);
+    vector< FrameSet<int> > sets = trigger(assembler, {2, 2}, 2*PERIOD_NS);
+
+    ASSERT_EQ(1u, sets.size());
+    EXPECT_EQ(2, sets[0].frame_id);
+    EXPECT_TRUE(sets[0].complete);
+    // the master's frame of the given up set is handed back to release it
+    expect_dropped(assembler, {frame(0, 1)});
+
+}
+
+TEST(FrameSetAssembler, DropsStaleFramesAheadOfMatch) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(3, 0, 0, 4, false);
+    trigger(assembler, {0, 0, 0}, 0);
+    // the master's frame 1 is lost, the slaves' frames of that trigger can never be matched
+    EXPECT_TRUE(trigger(assembler, {-1, 1, 1}, PERIOD_NS).empty());
+    vector< FrameSet<int> > sets = trigger(assembler, {2, 2, 2}, 2*PERIOD_NS);
+
+    ASSERT_EQ(1u, sets.size());
+    EXPECT_TRUE(sets[0].complete);
+    EXPECT_EQ(frame(1, 2), sets[0].frames[1]);
+    EXPECT_EQ(frame(2, 2), sets[0].frames[2]);
+    expect_dropped(assembler, {frame(1, 1), frame(2, 1)});
+    EXPECT_EQ(2u, assembler.dropped_frames());
+
+}
+
+TEST(FrameSetAssembler, DropsStaleFramesOfMissingCamera) {
+
+    // a camera without a match loses its frames older than the set, they are counted for that camera
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, TOLERANCE_NS, 1, true);
+    assembler.add(1, 7, -PERIOD_NS, frame(1, 7));
+    assembler.add(0, 0, 0, frame(0, 0));
+    assembler.add(0, 1, PERIOD_NS, frame(0, 1));
+    vector< FrameSet<int> > sets = drain(assembler);
+
+    ASSERT_EQ(1u, sets.size());
+    EXPECT_FALSE(sets[0].complete);
+    expect_dropped(assembler, {frame(1, 7)});
+
+}
+
+TEST(FrameSetAssembler, CameraDropsOutAndRejoinsByTimestamp) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, TOLERANCE_NS, 2, true);
+    int64_t k = 0;
+    for (; k < 3; k++)
+        ASSERT_EQ(1u, trigger(assembler, {k, k}, k*PERIOD_NS).size());
+
+    // unplugged: the sets wait for the camera for window frames, then go out without it
+    vector< FrameSet<int> > offline;
+    for (; k < 8; k++) {
+        vector< FrameSet<int> > sets = trigger(assembler, {k, -1}, k*PERIOD_NS);
+        offline.insert(offline.end(), sets.begin(), sets.end());
+    }
+    ASSERT_EQ(3u, offline.size());
+    for (size_t s = 0; s < offline.size(); s++) {
+        EXPECT_EQ(3 + s, offline[s].frame_id);
+        EXPECT_FALSE(offline[s].complete);
+    }
+
+    // back with its frame ID starting over, the sets still waiting go out without it, the next ones are complete
+    assembler.rejoin(1);
+    vector< FrameSet<int> > sets = trigger(assembler, {k, 0}, k*PERIOD_NS);
+    ASSERT_EQ(3u, sets.size());
+    EXPECT_FALSE(sets[0].complete);
+    EXPECT_FALSE(sets[1].complete);
+    EXPECT_TRUE(sets[2].complete);
+    EXPECT_EQ(k, sets[2].frame_id);
+    EXPECT_EQ(frame(1, 0), sets[2].frames[1]);
+    for (k++; k < 12; k++) {
+        sets = trigger(assembler, {k, k - 8}, k*PERIOD_NS);
+        ASSERT_EQ(1u, sets.size());
+        EXPECT_TRUE(sets[0].complete);
+        EXPECT_EQ(frame(1, k - 8), sets[0].frames[1]);
+    }
+    EXPECT_EQ(7u, assembler.complete_sets());
+    EXPECT_EQ(5u, assembler.partial_sets());
+
+}
+
+TEST(FrameSetAssembler, CameraDropsOutAndRejoinsByFrameId) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, 0, 2, true);
+    int64_t k = 0;
+    for (; k < 3; k++)
+        ASSERT_EQ(1u, trigger(assembler, {k, k}, k*PERIOD_NS).size());
+    for (; k < 8; k++)
+        trigger(assembler, {k, -1}, k*PERIOD_NS);
+
+    // without timestamps the first frame after the reconnect belongs to the newest set
+    assembler.rejoin(1);
+    vector< FrameSet<int> > sets = trigger(assembler, {k, 0}, k*PERIOD_NS);
+    ASSERT_EQ(3u, sets.size());
+    EXPECT_FALSE(sets[0].complete);
+    EXPECT_FALSE(sets[1].complete);
+    EXPECT_TRUE(sets[2].complete);
+    EXPECT_EQ(k, sets[2].frame_id);
+    EXPECT_EQ(frame(1, 0), sets[2].frames[1]);
+    sets = trigger(assembler, {k + 1, 1}, (k + 1)*PERIOD_NS);
+    ASSERT_EQ(1u, sets.size());
+    EXPECT_TRUE(sets[0].complete);
+    EXPECT_EQ(frame(1, 1), sets[0].frames[1]);
+
+}
+
+TEST(FrameSetAssembler, RejoinHandsBackWaitingFrames) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, TOLERANCE_NS, 4, true);
+    // frames of the camera from before it was reconnected never make it into a set
+    assembler.add(1, 5, 0, frame(1, 5));
+    assembler.add(1, 6, PERIOD_NS, frame(1, 6));
+    assembler.rejoin(1);
+    expect_dropped(assembler, {frame(1, 5), frame(1, 6)});
+
+}
+
+TEST(FrameSetAssembler, FlushHandsBackAllFrames) {
+
+    FrameSetAssembler<int> assembler;
+    assembler.init(2, 0, TOLERANCE_NS, 4, true);
+    trigger(assembler, {0, -1}, 0);
+    trigger(assembler, {1, -1}, PERIOD_NS);
+    assembler.add(1, 9, 5*PERIOD_NS, frame(1, 9));
+    assembler.flush();
+    // nothing was emitted, the two master frames were waiting for the slave
+    FrameSet<int> set;
+    EXPECT_FALSE(assembler.next(set));
+    expect_dropped(assembler, {frame(0, 0), frame(0, 1), frame(1, 9)});
+
+}
+
+int main(int argc, char **argv) {
+
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+
+}